@@ -0,0 +1,99 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Bounded queue for a single producer thread and a single consumer thread. push() and pop() don't take a lock while
+// the queue is neither empty nor parked: the mutex is only used to put the consumer to sleep when the queue is empty,
+// and by the producer to wake it up.
+// Several producer threads may share the queue if their calls to push() are serialized by a lock of their own.
+template <typename T>
+class SpscQueue
+{
+   public:
+    typedef size_t size_type;
+
+    SpscQueue(const size_type maxSize) : m_head(0), m_tail(0), m_sleeping(false)
+    {
+        size_type capacity = 1;
+        while (capacity < maxSize) capacity <<= 1;
+        m_buffer.resize(capacity);
+        m_mask = capacity - 1;
+    }
+
+    bool empty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+
+    size_type size() const
+    {
+        const size_type tail = m_tail.load(std::memory_order_acquire);
+        return tail - m_head.load(std::memory_order_acquire);
+    }
+
+    //! Producer side. Returns false if the queue is full
+    bool push(const T& val)
+    {
+        const size_type tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+            return false;
+        m_buffer[tail & m_mask] = val;
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        // pairs with the fence in pop(): either the consumer sees the new element or the producer sees it sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed))
+        {
+            std::lock_guard lk(m_mtx);
+            m_cond.notify_one();
+        }
+        return true;
+    }
+
+    //! Consumer side. Returns false if the queue is empty
+    bool tryPop(T& val)
+    {
+        const size_type head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        val = m_buffer[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Consumer side. Waits for an element if the queue is empty
+    T pop()
+    {
+        T val;
+        for (int spin = 0; spin < SPIN_COUNT; ++spin)
+            if (tryPop(val))
+                return val;
+
+        std::unique_lock lk(m_mtx);
+        while (true)
+        {
+            m_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (tryPop(val))
+                break;
+            m_cond.wait(lk);
+        }
+        m_sleeping.store(false, std::memory_order_relaxed);
+        return val;
+    }
+
+   private:
+    static constexpr int SPIN_COUNT = 64;
+
+    std::vector<T> m_buffer;
+    size_type m_mask;
+    alignas(64) std::atomic<size_type> m_head;  // next element to pop, written by the consumer
+    alignas(64) std::atomic<size_type> m_tail;  // next free slot, written by the producer
+    alignas(64) std::atomic<bool> m_sleeping;   // the consumer is waiting on m_cond
+    std::mutex m_mtx;
+    std::condition_variable m_cond;
+};
+
+#endif  // SPSC_QUEUE_H
@@ -15,6 +15,9 @@ class AbstractStream
     static constexpr unsigned int ofOpenExisting = 8;  // do not create file if absent
     static constexpr unsigned int ofCreateNew = 16;    // create new file. Return error If file exist
     static constexpr unsigned int ofNoTruncate = 32;   // keep file data while opening
+    static constexpr unsigned int ofDirectIO = 64;     // bypass the system cache if possible (not used on Windows)
+    static constexpr unsigned int ofDropCache = 128;   // drop the data from the system cache once it has been read or
+                                                       // written (not used on Windows)
 
     virtual bool open(const char* fName, unsigned int oflag, unsigned int systemDependentFlags = 0) = 0;
     virtual bool close() = 0;
@@ -26,6 +29,25 @@ class AbstractOutputStream : public AbstractStream
    public:
     virtual int write(const void* buffer, uint32_t count) = 0;
     int write(const std::vector<std::uint8_t>& data) { return write(data.data(), static_cast<uint32_t>(data.size())); }
+    //! Write several buffers one after another
+    /*!
+            \return The number of bytes written, -1 in case of an error.
+    */
+    virtual int64_t writev(const void* const* buffers, const uint32_t* counts, const int bufferCnt)
+    {
+        int64_t total = 0;
+        for (int i = 0; i < bufferCnt; ++i)
+        {
+            if (write(buffers[i], counts[i]) != static_cast<int>(counts[i]))
+                return -1;
+            total += counts[i];
+        }
+        return total;
+    }
+    //! Reserve disk space for the data to be written. Returns false if it isn't supported.
+    virtual bool preallocate(int64_t size) { return false; }
+    //! Alignment of the position and the size of the writes which bypass the system cache, 0 if the writes are cached
+    [[nodiscard]] virtual uint32_t directIOAlign() const { return 0; }
     virtual void sync() = 0;
 };
 
@@ -82,6 +104,26 @@ class File : public AbstractOutputStream
        full).
     */
     int write(const void* buffer, uint32_t count) override;
+    //! Write several buffers with a single call to the system
+    /*!
+            \return The number of bytes written into the file. -1 in case of an error.
+    */
+    int64_t writev(const void* const* buffers, const uint32_t* counts, int bufferCnt) override;
+    //! Reserve disk space for the file
+    /*!
+            The file size is not changed. The space which is not written is released when the file is closed.
+            \param size Expected size of the file.
+            \return true if the space has been reserved.
+    */
+    bool preallocate(int64_t size) override;
+    //! Alignment of the direct IO writes
+    /*!
+            The file writes blocks aligned to this size directly. A partial last block is padded, written again when
+            the next data is appended, and the padding is cut when the file is closed. Once a write is neither aligned
+            nor appended, the rest of the file goes through the system cache.
+            \return The alignment reported by the file system, 0 if the file isn't opened for direct IO.
+    */
+    [[nodiscard]] uint32_t directIOAlign() const override { return m_directIOAlign; }
     //! Write changes into the disk.
     /*!
             Write changes into the disk
@@ -126,9 +168,24 @@ class File : public AbstractOutputStream
     uint64_t pos() const { return m_pos; }
 
    private:
+    // direct IO writes, not used on Windows
+    void initDirectIO();
+    [[nodiscard]] bool isDirectWritable(uint32_t count) const;
+    int directWrite(const void* buffer, uint32_t count);
+    bool writeTail(int64_t blockPos);
+    void leaveDirectIO();
+
     void* m_impl;
     std::string m_name;
     mutable int64_t m_pos;
+    bool m_preallocated = false;
+    bool m_dropCache = false;
+    mutable int64_t m_cachePos = 0;  // data before this position has been dropped from the system cache
+    uint32_t m_directIOAlign = 0;     // alignment of the position and the size of the writes, 0 without direct IO
+    uint32_t m_directIOMemAlign = 0;  // alignment of the buffers written
+    int64_t m_fileEnd = 0;            // end of the data written
+    std::vector<uint8_t> m_tail;      // data of the last block if it is partial, it is written again with the next data
+    bool m_paddedTail = false;        // a partial last block has been padded beyond m_fileEnd
 };
 
 class FileFactory
@@ -11,9 +11,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
 #include <sstream>
+#include <vector>
 
 #include "../directory.h"
 #include "../file.h"
@@ -23,6 +28,31 @@ namespace
 int to_fd(void* impl) { return static_cast<int>(reinterpret_cast<std::intptr_t>(impl)); }
 void* from_fd(int fd) { return reinterpret_cast<void*>(static_cast<std::intptr_t>(fd)); }
 
+// The data is dropped from the system cache by chunks, the last chunk read or written is kept in the cache as the
+// stream can step back a little.
+constexpr int64_t DROP_CACHE_CHUNK = 8 * 1024 * 1024;
+
+// Drop the data before pos from the system cache. Dirty pages can't be dropped: for written data, wait for the
+// writeback of the previous chunk and start the writeback of the last one.
+void dropCache(const int fd, const int64_t pos, int64_t& cachePos, const bool written)
+{
+    const int64_t dropEnd = pos - DROP_CACHE_CHUNK;
+    if (dropEnd - cachePos < DROP_CACHE_CHUNK)
+        return;
+#ifdef SYNC_FILE_RANGE_WRITE
+    if (written)
+    {
+        sync_file_range(fd, cachePos, dropEnd - cachePos,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        sync_file_range(fd, dropEnd, pos - dropEnd, SYNC_FILE_RANGE_WRITE);
+    }
+#endif
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd, cachePos, dropEnd - cachePos, POSIX_FADV_DONTNEED);
+#endif
+    cachePos = dropEnd;
+}
+
 int makeUnixOpenFlags(unsigned int oflag)
 {
     int sysFlags = 0;
@@ -48,8 +78,74 @@ int makeUnixOpenFlags(unsigned int oflag)
     }
     if (oflag & File::ofCreateNew)
         sysFlags |= O_CREAT | O_EXCL;
+#ifdef O_DIRECT
+    if (oflag & File::ofDirectIO)
+        sysFlags |= O_DIRECT;
+#endif
     return sysFlags;
 }
+
+int openFile(const char* fName, const int sysFlags)
+{
+    constexpr mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP;
+    int fd = ::open(fName, sysFlags, mode);
+#ifdef O_DIRECT
+    // the file system doesn't support direct IO: use the system cache
+    if (fd == -1 && errno == EINVAL && (sysFlags & O_DIRECT))
+        fd = ::open(fName, sysFlags & ~O_DIRECT, mode);
+#endif
+    return fd;
+}
+
+bool isAligned(const void* buffer, const uint32_t align)
+{
+    return reinterpret_cast<std::uintptr_t>(buffer) % align == 0;
+}
+
+#ifdef O_DIRECT
+// Used if the file system doesn't report the alignment of direct IO: the largest logical sector size of the disks
+constexpr uint32_t DEFAULT_DIRECT_IO_ALIGN = 4096;
+
+// Aligned copy of the data for direct IO writes from a misaligned buffer
+class AlignedBuffer
+{
+   public:
+    ~AlignedBuffer() { free(m_data); }
+
+    uint8_t* get(const size_t size, const uint32_t align)
+    {
+        if (size > m_size || align > m_align)
+        {
+            free(m_data);
+            m_size = 0;
+            m_align = std::max(align, DEFAULT_DIRECT_IO_ALIGN);
+            if (posix_memalign(&m_data, m_align, size) != 0)
+                m_data = nullptr;
+            else
+                m_size = size;
+        }
+        return static_cast<uint8_t*>(m_data);
+    }
+
+   private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+    uint32_t m_align = 0;
+};
+
+// Writes count bytes at the current position, which is aligned, from a buffer aligned to memAlign if possible
+int writeAligned(const int fd, const void* buffer, const uint32_t count, const uint32_t memAlign)
+{
+    if (isAligned(buffer, memAlign))
+        return static_cast<int>(::write(fd, buffer, count));
+    thread_local AlignedBuffer alignedBuffer;
+    uint8_t* data = alignedBuffer.get(count, memAlign);
+    if (!data)
+        return -1;
+    memcpy(data, buffer, count);
+    return static_cast<int>(::write(fd, data, count));
+}
+#endif
 }  // namespace
 
 File::File() : m_impl(from_fd(-1)), m_pos(0) {}
@@ -57,7 +153,7 @@ File::File() : m_impl(from_fd(-1)), m_pos(0) {}
 File::File(const char* fName, unsigned int oflag, unsigned int systemDependentFlags) : m_name(fName), m_pos(0)
 {
     int sysFlags = makeUnixOpenFlags(oflag);
-    auto fd = ::open(fName, sysFlags | systemDependentFlags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    auto fd = openFile(fName, sysFlags | static_cast<int>(systemDependentFlags));
     if (fd == -1)
     {
         std::ostringstream ss;
@@ -65,6 +161,12 @@ File::File(const char* fName, unsigned int oflag, unsigned int systemDependentFl
         throw std::runtime_error(ss.str());
     }
     m_impl = from_fd(fd);
+    m_dropCache = oflag & ofDropCache;
+    initDirectIO();
+#ifdef POSIX_FADV_SEQUENTIAL
+    if ((oflag & ofRead) && !(oflag & ofWrite))
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 }
 
 File::~File()
@@ -82,14 +184,43 @@ bool File::open(const char* fName, unsigned int oflag, unsigned int systemDepend
 
     int sysFlags = makeUnixOpenFlags(oflag);
     createDir(extractFileDir(fName), true);
-    auto fd = ::open(fName, sysFlags | systemDependentFlags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    auto fd = openFile(fName, sysFlags | static_cast<int>(systemDependentFlags));
     m_impl = from_fd(fd);
+    m_pos = 0;
+    m_dropCache = oflag & ofDropCache;
+    m_cachePos = 0;
+    if (fd != -1)
+        initDirectIO();
+#ifdef POSIX_FADV_SEQUENTIAL
+    // same as FILE_FLAG_SEQUENTIAL_SCAN on Windows: read-only files are read sequentially
+    if (fd != -1 && (oflag & ofRead) && !(oflag & ofWrite))
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
     return fd != -1;
 }
 
 bool File::close()
 {
-    if (::close(to_fd(m_impl)) == 0)
+    const int fd = to_fd(m_impl);
+    if (m_paddedTail)
+    {
+        // cut the padding of the last block written with direct IO, the reserved space beyond it is released too
+        ftruncate(fd, m_fileEnd);
+        m_paddedTail = false;
+        m_preallocated = false;
+    }
+#ifdef FALLOC_FL_KEEP_SIZE
+    if (m_preallocated)
+    {
+        // release the reserved space beyond the end of the file
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+            ftruncate(fd, st.st_size);
+        m_preallocated = false;
+    }
+#endif
+    m_directIOAlign = 0;
+    if (::close(fd) == 0)
     {
         m_impl = from_fd(-1);
         return true;
@@ -98,20 +229,224 @@ bool File::close()
     return false;
 }
 
+void File::initDirectIO()
+{
+    m_directIOAlign = m_directIOMemAlign = 0;
+    m_fileEnd = 0;
+    m_tail.clear();
+    m_paddedTail = false;
+#ifdef O_DIRECT
+    const int fd = to_fd(m_impl);
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || !(flags & O_DIRECT))
+        return;
+    struct stat st;
+    if ((flags & O_APPEND) || fstat(fd, &st) != 0)
+    {
+        // the position of appended data is unknown
+        fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+        return;
+    }
+    m_fileEnd = st.st_size;
+    m_directIOAlign = m_directIOMemAlign = DEFAULT_DIRECT_IO_ALIGN;
+#ifdef STATX_DIOALIGN
+    struct statx stx;
+    if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN) &&
+        stx.stx_dio_offset_align > 0)
+    {
+        m_directIOAlign = stx.stx_dio_offset_align;
+        m_directIOMemAlign = std::max(stx.stx_dio_mem_align, 1u);
+    }
+#endif
+#endif
+}
+
+bool File::isDirectWritable(const uint32_t count) const
+{
+    // data appended to a partial last block
+    if (m_pos % m_directIOAlign != 0)
+        return m_pos == m_fileEnd && !m_tail.empty();
+    // a partial last block is only written at the end of the data
+    return count % m_directIOAlign == 0 || m_pos + count >= m_fileEnd;
+}
+
+bool File::writeTail(const int64_t blockPos)
+{
+#ifdef O_DIRECT
+    thread_local AlignedBuffer tailBuffer;
+    uint8_t* data = tailBuffer.get(m_directIOAlign, m_directIOMemAlign);
+    if (!data)
+        return false;
+    memcpy(data, m_tail.data(), m_tail.size());
+    memset(data + m_tail.size(), 0, m_directIOAlign - m_tail.size());
+    if (pwrite(to_fd(m_impl), data, m_directIOAlign, blockPos) != static_cast<ssize_t>(m_directIOAlign))
+        return false;
+    m_paddedTail = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+int File::directWrite(const void* buffer, const uint32_t count)
+{
+#ifdef O_DIRECT
+    const int fd = to_fd(m_impl);
+    const auto data = static_cast<const uint8_t*>(buffer);
+    if (m_pos % m_directIOAlign == 0 && count % m_directIOAlign == 0)
+    {
+        if (m_pos + count >= m_fileEnd)
+            m_tail.clear();
+        return writeAligned(fd, data, count, m_directIOMemAlign);
+    }
+
+    // the partial blocks are written at their position, the file position is set after the data at the end
+    uint32_t headLen = 0;
+    if (m_pos % m_directIOAlign != 0)
+    {
+        const auto tailLen = static_cast<uint32_t>(m_tail.size());
+        headLen = std::min(count, m_directIOAlign - tailLen);
+        m_tail.insert(m_tail.end(), data, data + headLen);
+        if (!writeTail(m_pos - tailLen))
+            return -1;
+        if (m_tail.size() == m_directIOAlign)
+            m_tail.clear();
+    }
+    const uint32_t tailLen = (count - headLen) % m_directIOAlign;
+    const uint32_t alignedLen = count - headLen - tailLen;
+    if (alignedLen > 0)
+    {
+        lseek(fd, m_pos + headLen, SEEK_SET);
+        if (writeAligned(fd, data + headLen, alignedLen, m_directIOMemAlign) != static_cast<int>(alignedLen))
+            return -1;
+    }
+    if (tailLen > 0)
+    {
+        m_tail.assign(data + count - tailLen, data + count);
+        if (!writeTail(m_pos + count - tailLen))
+            return -1;
+    }
+    lseek(fd, m_pos + count, SEEK_SET);
+    return static_cast<int>(count);
+#else
+    return -1;
+#endif
+}
+
+void File::leaveDirectIO()
+{
+#ifdef O_DIRECT
+    const int fd = to_fd(m_impl);
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags != -1)
+        fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+    // a failed write may have written a part of the data
+    lseek(fd, m_pos, SEEK_SET);
+#endif
+    m_directIOAlign = 0;
+    m_tail.clear();
+}
+
 int File::read(void* buffer, uint32_t count) const
 {
     if (!isOpen())
         return -1;
     m_pos += count;
-    return ::read(to_fd(m_impl), buffer, count);
+    const int rez = ::read(to_fd(m_impl), buffer, count);
+    if (m_dropCache)
+        dropCache(to_fd(m_impl), m_pos, m_cachePos, false);
+    return rez;
 }
 
 int File::write(const void* buffer, uint32_t count)
 {
     if (!isOpen())
         return -1;
+    int rez = -1;
+    if (m_directIOAlign > 0)
+    {
+        if (isDirectWritable(count))
+            rez = directWrite(buffer, count);
+        // the file system rejects the write or the data isn't aligned: the rest of the file is written through the cache
+        if (rez == -1 && (errno == EINVAL || !isDirectWritable(count)))
+            leaveDirectIO();
+    }
+    if (m_directIOAlign == 0)
+        rez = ::write(to_fd(m_impl), buffer, count);
     m_pos += count;
-    return ::write(to_fd(m_impl), buffer, count);
+    m_fileEnd = std::max(m_fileEnd, m_pos);
+    if (m_dropCache)
+        dropCache(to_fd(m_impl), m_pos, m_cachePos, true);
+    return rez;
+}
+
+int64_t File::writev(const void* const* buffers, const uint32_t* counts, const int bufferCnt)
+{
+    if (!isOpen())
+        return -1;
+    std::vector<iovec> iov;
+    iov.reserve(bufferCnt);
+    int64_t total = 0;
+    for (int i = 0; i < bufferCnt; ++i)
+    {
+        if (counts[i] > 0)
+            iov.push_back({const_cast<void*>(buffers[i]), counts[i]});
+        total += counts[i];
+    }
+
+    if (m_directIOAlign > 0)
+    {
+        // the buffers are written one by one if some of them are not aligned for direct IO
+        bool directWritable = m_pos % m_directIOAlign == 0;
+        for (size_t i = 0; i < iov.size() && directWritable; ++i)
+            directWritable = iov[i].iov_len % m_directIOAlign == 0 && isAligned(iov[i].iov_base, m_directIOMemAlign);
+        if (!directWritable)
+        {
+            for (const auto& buffer : iov)
+                if (write(buffer.iov_base, static_cast<uint32_t>(buffer.iov_len)) != static_cast<int>(buffer.iov_len))
+                    return -1;
+            return total;
+        }
+    }
+
+    size_t first = 0;
+    while (first < iov.size())
+    {
+        const int iovCnt = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+        const ssize_t rez = ::writev(to_fd(m_impl), &iov[first], iovCnt);
+        if (rez == -1 && errno == EINTR)
+            continue;
+#ifdef O_DIRECT
+        // the file system rejects the direct IO: write the buffers one by one, with the fallback of write()
+        if (rez == -1 && errno == EINVAL && m_directIOAlign > 0)
+        {
+            leaveDirectIO();
+            for (; first < iov.size(); ++first)
+                if (write(iov[first].iov_base, static_cast<uint32_t>(iov[first].iov_len)) !=
+                    static_cast<int>(iov[first].iov_len))
+                    return -1;
+            break;
+        }
+#endif
+        if (rez <= 0)
+            return -1;
+        m_pos += rez;
+        // skip the buffers written, a partial write continues from the middle of a buffer
+        for (auto done = static_cast<size_t>(rez); done > 0; ++first)
+        {
+            if (done < iov[first].iov_len)
+            {
+                iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + done;
+                iov[first].iov_len -= done;
+                break;
+            }
+            done -= iov[first].iov_len;
+        }
+    }
+    m_fileEnd = std::max(m_fileEnd, m_pos);
+    if (m_dropCache)
+        dropCache(to_fd(m_impl), m_pos, m_cachePos, true);
+    return total;
 }
 
 bool File::isOpen() const { return to_fd(m_impl) != -1; }
@@ -124,7 +459,8 @@ bool File::size(int64_t* const fileSize) const
 
     if (isOpen() && (fstat(to_fd(m_impl), &buf) == 0))
     {
-        *fileSize = buf.st_size;
+        // the padding of the last block written with direct IO is not a part of the file
+        *fileSize = m_paddedTail ? m_fileEnd : buf.st_size;
         res = true;
     }
 
@@ -149,8 +485,22 @@ int64_t File::seek(const int64_t offset, const SeekMethod whence) const
         sWhence = SEEK_END;
         break;
     }
-    m_pos = offset;
-    return lseek(to_fd(m_impl), offset, sWhence);
+    const off_t rez = lseek(to_fd(m_impl), offset, sWhence);
+    if (rez != -1)
+        m_pos = rez;
+    return rez;
+}
+
+bool File::preallocate(const int64_t size)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+    if (!isOpen() || size <= 0 || fallocate(to_fd(m_impl), FALLOC_FL_KEEP_SIZE, 0, size) != 0)
+        return false;
+    m_preallocated = true;
+    return true;
+#else
+    return false;
+#endif
 }
 
 bool File::truncate(const uint64_t newFileSize) const { return ftruncate(to_fd(m_impl), newFileSize) == 0; }
@@ -165,6 +165,12 @@ int File::write(const void* buffer, const uint32_t count)
     return static_cast<int>(bytesWritten);
 }
 
+int64_t File::writev(const void* const* buffers, const uint32_t* counts, const int bufferCnt)
+{
+    // WriteFileGather() requires unbuffered files and page sized buffers
+    return AbstractOutputStream::writev(buffers, counts, bufferCnt);
+}
+
 void File::sync() { FlushFileBuffers(m_impl); }
 
 bool File::isOpen() const { return m_impl != INVALID_HANDLE_VALUE; }
@@ -212,6 +218,15 @@ int64_t File::seek(const int64_t offset, const SeekMethod whence) const
     return m_pos;
 }
 
+bool File::preallocate(const int64_t size)
+{
+    // NTFS releases the allocation beyond the end of the file when the file is closed
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = size;
+    return isOpen() && size > 0 &&
+           SetFileInformationByHandle(m_impl, FileAllocationInfo, &info, sizeof(info)) != FALSE;
+}
+
 bool File::truncate(const uint64_t newFileSize) const
 {
     const LONG distanceToMoveLow = static_cast<LONG>(newFileSize);
@@ -5,3 +5,55 @@ AbstractDemuxer::~AbstractDemuxer()
 {
     for (const auto &m_pidFilter : m_pidFilters) delete m_pidFilter.second;
 }
+
+// ------------------------------ MemoryBlockPool --------------------------------
+
+MemoryBlockPool& MemoryBlockPool::instance()
+{
+    static MemoryBlockPool pool;
+    return pool;
+}
+
+MemoryBlockPool::~MemoryBlockPool()
+{
+    for (const auto& buffer : m_freeBuffers) delete[] buffer.second;
+}
+
+uint8_t* MemoryBlockPool::acquire(size_t& size)
+{
+    if (size >= MIN_POOLED_SIZE)
+    {
+        std::lock_guard lock(m_mtx);
+        // smallest free buffer large enough
+        auto best = m_freeBuffers.end();
+        for (auto itr = m_freeBuffers.begin(); itr != m_freeBuffers.end(); ++itr)
+        {
+            if (itr->first >= size && (best == m_freeBuffers.end() || itr->first < best->first))
+                best = itr;
+        }
+        if (best != m_freeBuffers.end())
+        {
+            uint8_t* buffer = best->second;
+            size = best->first;
+            m_pooledBytes -= size;
+            m_freeBuffers.erase(best);
+            return buffer;
+        }
+    }
+    return new uint8_t[size];
+}
+
+void MemoryBlockPool::release(uint8_t* buffer, const size_t size)
+{
+    if (size >= MIN_POOLED_SIZE)
+    {
+        std::lock_guard lock(m_mtx);
+        if (m_pooledBytes + size <= MAX_POOLED_BYTES)
+        {
+            m_freeBuffers.emplace_back(size, buffer);
+            m_pooledBytes += size;
+            return;
+        }
+    }
+    delete[] buffer;
+}
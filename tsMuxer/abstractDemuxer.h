@@ -2,10 +2,15 @@
 #define ABSTRACT_DEMUXER_H_
 
 #include <assert.h>
+#include <algorithm>
 #include <cstring>
+#include <deque>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <types/types.h>
 
@@ -14,32 +19,64 @@
 
 class SubTrackFilter;
 
+// Buffers of the MemoryBlocks, shared by all of them. The large buffers released by a block are kept for the blocks
+// allocated later, so the demux buffers are reused from one track or file to the next.
+class MemoryBlockPool
+{
+   public:
+    static MemoryBlockPool& instance();
+
+    // uninitialized buffer of at least size bytes. size is updated to the actual size of the buffer.
+    uint8_t* acquire(size_t& size);
+    void release(uint8_t* buffer, size_t size);
+
+   private:
+    static constexpr size_t MIN_POOLED_SIZE = 64 * 1024;
+    static constexpr size_t MAX_POOLED_BYTES = 64 * 1024 * 1024;
+
+    MemoryBlockPool() : m_pooledBytes(0) {}
+    ~MemoryBlockPool();
+
+    std::mutex m_mtx;
+    std::vector<std::pair<size_t, uint8_t*>> m_freeBuffers;
+    size_t m_pooledBytes;
+};
+
+// Growable byte buffer. Growing the buffer doesn't initialize the new bytes: they are expected to be written by the
+// caller.
 class MemoryBlock
 {
    public:
-    MemoryBlock(const MemoryBlock& other)
+    MemoryBlock() : m_data(nullptr), m_capacity(0), m_start(0), m_size(0) {}
+
+    MemoryBlock(const MemoryBlock& other) : MemoryBlock() { assert(other.size() == 0); }
+    MemoryBlock& operator=(const MemoryBlock&) = delete;
+
+    ~MemoryBlock()
     {
-        assert(other.m_size == 0);
-        m_size = 0;
+        if (m_data)
+            MemoryBlockPool::instance().release(m_data, m_capacity);
     }
 
-    MemoryBlock() : m_size(0) {}
-    void reserve(const unsigned num) { m_data.resize(num); }
+    void reserve(const unsigned num)
+    {
+        if (m_start + num > m_capacity)
+            setCapacity(FFMAX(num, size()));
+    }
 
     void resize(const unsigned num)
     {
-        m_size = num;
-        if (m_data.size() < m_size)
-            m_data.resize(m_size);
+        if (m_start + num > m_capacity)
+            setCapacity(num);
+        m_size = m_start + num;
     }
 
     void grow(const size_t num)
     {
-        m_size += num;
-        if (m_data.size() < m_size)
-        {
-            m_data.resize(FFMIN(m_size * 2, m_size + 1024LL * 1024));
-        }
+        const size_t newSize = size() + num;
+        if (m_start + newSize > m_capacity)
+            setCapacity(FFMIN(newSize * 2, newSize + 1024LL * 1024));
+        m_size = m_start + newSize;
     }
 
     void append(const uint8_t* data, const size_t num)
@@ -47,27 +84,113 @@ class MemoryBlock
         if (num > 0)
         {
             grow(num);
-            memcpy(&m_data[m_size - num], data, num);
+            memcpy(m_data + m_size - num, data, num);
         }
     }
 
-    [[nodiscard]] size_t size() const { return m_size; }
+    // Drops num bytes at the start of the block. The space is reclaimed once the dropped bytes outweigh the data left,
+    // so each byte is moved at most once per byte dropped instead of on every call.
+    void skip(const size_t num)
+    {
+        m_start += num;
+        assert(m_start <= m_size);
+        if (m_start >= m_size - m_start)
+        {
+            memmove(m_data, m_data + m_start, m_size - m_start);
+            m_size -= m_start;
+            m_start = 0;
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return m_size - m_start; }
 
-    uint8_t* data() { return m_data.empty() ? nullptr : m_data.data(); }
+    uint8_t* data() { return m_data ? m_data + m_start : nullptr; }
 
-    [[nodiscard]] bool isEmpty() const { return m_size == 0; }
+    [[nodiscard]] bool isEmpty() const { return m_size == m_start; }
 
-    void clear() { m_size = 0; }
+    void clear() { m_start = m_size = 0; }
 
    private:
-    std::vector<uint8_t> m_data;
+    // moves the data to a new buffer of the pool
+    void setCapacity(size_t capacity)
+    {
+        uint8_t* data = MemoryBlockPool::instance().acquire(capacity);
+        if (m_data)
+        {
+            memcpy(data, m_data + m_start, size());
+            MemoryBlockPool::instance().release(m_data, m_capacity);
+        }
+        m_size -= m_start;
+        m_start = 0;
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    uint8_t* m_data;
+    size_t m_capacity;
+    size_t m_start;  // offset of the first byte not dropped by skip()
     size_t m_size;
 };
 
 typedef MemoryBlock StreamData;
-typedef std::map<int32_t, StreamData> DemuxedData;
+
+// Demuxed data of the tracks of a container, by track ID. The data of the tracks is stored in a flat container and is
+// never moved when tracks are added, so the references to it stay valid. The tracks are iterated by increasing ID.
+class DemuxedData
+{
+   public:
+    typedef std::pair<const int32_t, StreamData> value_type;
+
+    class iterator
+    {
+       public:
+        explicit iterator(const std::vector<value_type*>::const_iterator itr) : m_itr(itr) {}
+        value_type& operator*() const { return **m_itr; }
+        value_type* operator->() const { return *m_itr; }
+        iterator& operator++()
+        {
+            ++m_itr;
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return m_itr == other.m_itr; }
+        bool operator!=(const iterator& other) const { return m_itr != other.m_itr; }
+
+       private:
+        std::vector<value_type*>::const_iterator m_itr;
+    };
+
+    DemuxedData() : m_lastTrack(nullptr) {}
+    DemuxedData(const DemuxedData&) = delete;
+    DemuxedData& operator=(const DemuxedData&) = delete;
+
+    // data of the track, an empty block is added on first access
+    StreamData& operator[](const int32_t trackID)
+    {
+        // consecutive accesses are usually for the same track
+        if (m_lastTrack && m_lastTrack->first == trackID)
+            return m_lastTrack->second;
+        auto itr = std::lower_bound(m_index.begin(), m_index.end(), trackID,
+                                    [](const value_type* track, const int32_t id) { return track->first < id; });
+        if (itr == m_index.end() || (*itr)->first != trackID)
+        {
+            m_tracks.emplace_back(std::piecewise_construct, std::forward_as_tuple(trackID), std::forward_as_tuple());
+            itr = m_index.insert(itr, &m_tracks.back());
+        }
+        m_lastTrack = *itr;
+        return m_lastTrack->second;
+    }
+
+    [[nodiscard]] iterator begin() const { return iterator(m_index.begin()); }
+    [[nodiscard]] iterator end() const { return iterator(m_index.end()); }
+    [[nodiscard]] size_t size() const { return m_index.size(); }
+
+   private:
+    std::deque<value_type> m_tracks;   // in order of creation
+    std::vector<value_type*> m_index;  // sorted by track ID
+    value_type* m_lastTrack;
+};
+
 typedef std::set<int32_t> PIDSet;
-// typedef std::map<uint32_t, std::vector<uint8_t> > DemuxedData;
 
 // Used to automatically switch to reading the next file while the current one ends.
 // This class implements file-IO, which determines the name of the next file.
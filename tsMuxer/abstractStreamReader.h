@@ -13,6 +13,8 @@
 
 static constexpr int PTS_CONST_OFFSET = 0;
 
+class V3Info;
+
 class AbstractStreamReader : public BaseAbstractStreamReader
 {
    public:
@@ -44,7 +46,8 @@ class AbstractStreamReader : public BaseAbstractStreamReader
           m_streamIndex(0),
           m_tmpBufferLen(0),
           m_demuxMode(false),
-          m_secondary(false)
+          m_secondary(false),
+          m_v3Info(nullptr)
     {
     }
 
@@ -76,6 +79,9 @@ class AbstractStreamReader : public BaseAbstractStreamReader
     void setIsSecondary(const bool value) { m_secondary = value; }
     void setPipParams(const PIPParams& params) { m_pipParams = params; }
     [[nodiscard]] PIPParams getPipParams() const { return m_pipParams; }
+    // Blu-ray V3 state of the mux job the stream belongs to
+    void setV3Info(V3Info* v3Info) { m_v3Info = v3Info; }
+    [[nodiscard]] V3Info* getV3Info() const { return m_v3Info; }
 
    protected:
     ContainerType m_containerType;
@@ -87,6 +93,7 @@ class AbstractStreamReader : public BaseAbstractStreamReader
     int64_t m_tmpBufferLen;
     bool m_demuxMode;
     bool m_secondary;
+    V3Info* m_v3Info;
 
     PIPParams m_pipParams;
 };
@@ -0,0 +1,601 @@
+#include "asyncFileReader.h"
+
+#include <fs/systemlog.h>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "vodCoreException.h"
+#include "vod_common.h"
+
+using namespace std;
+
+namespace
+{
+constexpr unsigned RING_ENTRIES = 64;
+constexpr uint64_t WAKE_USER_DATA = 0;
+
+int sys_io_uring_setup(const unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(const int fd, const unsigned toSubmit, const unsigned minComplete, const unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+}  // namespace
+
+// ---------------------------- AsyncReaderData ------------------------------
+
+AsyncReaderData::AsyncReaderData()
+    : m_inflight(0),
+      m_fd(-1),
+      m_fileSize(0),
+      m_filePos(0),
+      m_deliveredPos(0),
+      m_cachePos(0)
+{
+}
+
+AsyncReaderData::~AsyncReaderData()
+{
+    if (m_fd != -1)
+        ::close(m_fd);
+    closeRetiredFiles();
+}
+
+void AsyncReaderData::init()
+{
+    ReaderData::init();
+    m_requests.resize(m_blocks.size());
+    for (ReadRequest& request : m_requests) request.m_owner = this;
+}
+
+bool AsyncReaderData::openStream()
+{
+    init();
+    m_fd = ::open(m_streamName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd == -1)
+        return false;
+    struct stat st;
+    m_fileSize = fstat(m_fd, &st) == 0 ? st.st_size : INT64_MAX;
+    m_filePos = m_cachePos = 0;
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+bool AsyncReaderData::closeStream()
+{
+    if (m_fd == -1)
+        return false;
+    // reads of this file may still be in flight or about to be submitted, the descriptor is closed once they complete
+    m_retiredFiles.push_back(m_fd);
+    m_fd = -1;
+    return true;
+}
+
+int AsyncReaderData::readBlock(uint8_t* buffer, const uint32_t max_size)
+{
+    return m_fd == -1 ? -1 : static_cast<int>(::read(m_fd, buffer, max_size));
+}
+
+void AsyncReaderData::resetRequests()
+{
+    for (ReadRequest& request : m_requests) request.m_state = BlockState::Free;
+    resetBlocks();
+}
+
+void AsyncReaderData::closeRetiredFiles()
+{
+    for (const int fd : m_retiredFiles) ::close(fd);
+    m_retiredFiles.clear();
+}
+
+// ---------------------------- AsyncFileReader ------------------------------
+
+AsyncFileReader::AsyncFileReader(const uint32_t blockSize, const uint32_t allocSize, const uint32_t prereadThreshold,
+                                 const uint32_t readAheadDepth)
+    : BufferedReader(blockSize, allocSize, prereadThreshold, readAheadDepth ? readAheadDepth : ASYNC_READ_AHEAD_DEPTH),
+      m_ringFd(-1),
+      m_wakeFd(-1),
+      m_wakeValue(0),
+      m_wakePending(false),
+      m_ringEntries(0),
+      m_inflight(0),
+      m_toSubmit(0),
+      m_sqRing(MAP_FAILED),
+      m_sqRingSize(0),
+      m_cqRing(MAP_FAILED),
+      m_cqRingSize(0),
+      m_sqes(MAP_FAILED),
+      m_sqesSize(0),
+      m_sqHead(nullptr),
+      m_sqTail(nullptr),
+      m_sqMask(nullptr),
+      m_sqArray(nullptr),
+      m_cqHead(nullptr),
+      m_cqTail(nullptr),
+      m_cqMask(nullptr),
+      m_cqes(nullptr)
+{
+    if (!initRing())
+    {
+        closeRing();
+        THROW(ERR_COMMON, "Can't initialize io_uring: " << strerror(errno))
+    }
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+    {
+        std::lock_guard lk(m_readMtx);
+        m_terminated = true;
+    }
+    wakeUp();
+    join();
+    closeRing();
+}
+
+bool AsyncFileReader::isSupported()
+{
+    io_uring_params params{};
+    const int fd = sys_io_uring_setup(2, &params);
+    if (fd < 0)
+        return false;
+    ::close(fd);
+    // IORING_OP_READ was introduced together with this feature flag (kernel 5.6)
+    return (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+}
+
+bool AsyncFileReader::initRing()
+{
+    io_uring_params params{};
+    m_ringFd = sys_io_uring_setup(RING_ENTRIES, &params);
+    if (m_ringFd < 0)
+        return false;
+    m_ringEntries = params.sq_entries;
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+        m_sqRingSize = m_cqRingSize = max(m_sqRingSize, m_cqRingSize);
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                    IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED)
+        return false;
+    if (singleMmap)
+        m_cqRing = m_sqRing;
+    else
+    {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                        IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED)
+            return false;
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED)
+        return false;
+
+    const auto sq = static_cast<uint8_t*>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    const auto cq = static_cast<uint8_t*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = cq + params.cq_off.cqes;
+
+    m_wakeFd = eventfd(0, EFD_CLOEXEC);
+    return m_wakeFd != -1;
+}
+
+void AsyncFileReader::closeRing()
+{
+    if (m_sqes != MAP_FAILED)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing != MAP_FAILED)
+        munmap(m_sqRing, m_sqRingSize);
+    m_sqes = m_cqRing = m_sqRing = MAP_FAILED;
+    if (m_wakeFd != -1)
+        ::close(m_wakeFd);
+    if (m_ringFd != -1)
+        ::close(m_ringFd);
+    m_wakeFd = m_ringFd = -1;
+}
+
+void AsyncFileReader::wakeUp() const
+{
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t rez = ::write(m_wakeFd, &value, sizeof(value));
+}
+
+bool AsyncFileReader::submitRead(const int fd, void* buffer, const uint32_t len, const int64_t offset,
+                                 const uint64_t userData)
+{
+    const unsigned tail = *m_sqTail;
+    if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_ringEntries)
+        return false;
+    const unsigned index = tail & *m_sqMask;
+    auto sqe = static_cast<io_uring_sqe*>(m_sqes) + index;
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = len;
+    sqe->off = static_cast<uint64_t>(offset);
+    sqe->user_data = userData;
+    m_sqArray[index] = index;
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    m_toSubmit++;
+    return true;
+}
+
+void AsyncFileReader::submitWakeRead()
+{
+    // a pending read of the eventfd lets other threads interrupt the wait for completions
+    m_wakePending = submitRead(m_wakeFd, &m_wakeValue, sizeof(m_wakeValue), 0, WAKE_USER_DATA);
+}
+
+AsyncReaderData* AsyncFileReader::getAsyncReader(const int readerID)
+{
+    return static_cast<AsyncReaderData*>(getReader(readerID));
+}
+
+void AsyncFileReader::planNextBlock(AsyncReaderData* data, AsyncReaderData::ReadRequest& request,
+                                    ReaderData::Block& block) const
+{
+    // Produces exactly the sequence of blocks BufferedReader::thread_main() would read, including the switch to the
+    // next file of a file list, but without touching the data: the actual read is submitted by the caller.
+    const uint32_t blockSize = data->m_blockSize;
+    if (data->m_lastBlock)
+    {
+        data->m_lastBlock = false;
+        data->m_firstBlock = true;
+    }
+    else if (data->m_firstBlock)
+    {
+        data->m_firstBlock = false;
+    }
+
+    request.m_fd = data->m_fd;
+    request.m_offset = data->m_filePos;
+    const int64_t bytesLeft = data->m_fd == -1 ? 0 : max<int64_t>(data->m_fileSize - data->m_filePos, 0);
+    request.m_len = static_cast<uint32_t>(min<int64_t>(blockSize, bytesLeft));
+    data->m_filePos += request.m_len;
+
+    bool eof = false;
+    if (request.m_len == 0 || (request.m_len < blockSize && data->itr))
+    {
+        if (data->itr)
+        {
+            const std::string nextFileName = data->itr->getNextName();
+            if (nextFileName != data->m_streamName)
+            {
+                data->closeStream();
+                data->m_streamName = nextFileName;
+                if (!data->m_streamName.empty() && data->openStream())
+                {
+                    if (request.m_len == 0)
+                    {
+                        data->m_firstBlock = true;
+                        request.m_fd = data->m_fd;
+                        request.m_offset = 0;
+                        request.m_len = static_cast<uint32_t>(min<int64_t>(m_blockSize, data->m_fileSize));
+                        data->m_filePos = request.m_len;
+                        if (request.m_len < m_blockSize)
+                        {
+                            eof = true;
+                            data->m_lastBlock = true;
+                        }
+                    }
+                    else
+                    {
+                        data->m_lastBlock = true;
+                    }
+                }
+                else
+                    eof = true;
+            }
+        }
+        else
+        {
+            eof = true;
+        }
+    }
+
+    data->m_blockSize = m_blockSize;
+    if (request.m_len == 0)
+        eof = true;
+
+    block.m_size = 0;
+    block.m_eof = eof;
+    block.m_firstBlock = data->m_firstBlock;
+    data->m_eof = eof;
+}
+
+void AsyncFileReader::planReads(AsyncReaderData* data)
+{
+    if (data->m_deleted || data->m_eof || !(data->m_readAhead || data->m_notified))
+        return;
+    if (data->m_requests.empty())
+        data->init();
+
+    bool blockReady = false;
+    while (m_inflight < static_cast<int>(m_ringEntries) - 1 && data->hasFreeBlock())
+    {
+        AsyncReaderData::ReadRequest& request = data->tailRequest();
+        ReaderData::Block& block = data->tailBlock();
+        planNextBlock(data, request, block);
+        data->m_tail++;
+        data->m_notified = false;
+        if (request.m_len == 0)
+        {
+            request.m_state = AsyncReaderData::BlockState::Ready;
+            blockReady = true;
+        }
+        else
+        {
+            // the submission queue can't overflow: it never holds more entries than the reads in flight
+            submitRead(request.m_fd, block.m_data + data->m_readOffset, request.m_len, request.m_offset,
+                       reinterpret_cast<uint64_t>(&request));
+            request.m_state = AsyncReaderData::BlockState::Pending;
+            data->m_inflight++;
+            m_inflight++;
+        }
+        // without read-ahead only the block requested by readBlock() is read
+        if (data->m_eof || !data->m_readAhead)
+            break;
+    }
+    if (blockReady)
+        m_readCond.notify_all();
+}
+
+void AsyncFileReader::processCompletions()
+{
+    unsigned head = *m_cqHead;
+    const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+        return;
+
+    bool rearmWake = false;
+    {
+        std::lock_guard lk(m_readMtx);
+        for (; head != tail; ++head)
+        {
+            const auto cqe = static_cast<io_uring_cqe*>(m_cqes) + (head & *m_cqMask);
+            if (cqe->user_data == WAKE_USER_DATA)
+            {
+                m_wakePending = false;
+                rearmWake = !m_terminated;
+                continue;
+            }
+            const auto request = reinterpret_cast<AsyncReaderData::ReadRequest*>(cqe->user_data);
+            AsyncReaderData* data = request->m_owner;
+            ReaderData::Block& block = data->m_blocks[request - data->m_requests.data()];
+            if (cqe->res < 0)
+                LTRACE(LT_ERROR, 0, "Error reading file " << data->m_streamName << ": " << strerror(-cqe->res));
+            block.m_size = max(cqe->res, 0);
+            if (block.m_size != static_cast<int>(request->m_len))
+            {
+                // the file is shorter than expected: stop reading this stream after this block
+                block.m_eof = true;
+                data->m_eof = true;
+            }
+            request->m_state = AsyncReaderData::BlockState::Ready;
+            m_inflight--;
+            if (--data->m_inflight == 0)
+                data->closeRetiredFiles();
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        m_readCond.notify_all();
+    }
+    if (rearmWake)
+        submitWakeRead();
+}
+
+void AsyncFileReader::thread_main()
+{
+    try
+    {
+        submitWakeRead();
+        while (true)
+        {
+            {
+                std::lock_guard readersLock(m_readersMtx);
+                std::lock_guard lk(m_readMtx);
+                if (m_terminated && m_inflight == 0 && !m_wakePending)
+                    break;
+                if (!m_terminated)
+                    for (const auto& reader : m_readers) planReads(static_cast<AsyncReaderData*>(reader.second));
+            }
+            const int rez = sys_io_uring_enter(m_ringFd, m_toSubmit, 1, IORING_ENTER_GETEVENTS);
+            if (rez < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    continue;
+                THROW(ERR_COMMON, "io_uring_enter failed: " << strerror(errno))
+            }
+            m_toSubmit -= min(rez, m_toSubmit);
+            processCompletions();
+        }
+    }
+    catch (VodCoreException& e)
+    {
+        LTRACE(LT_ERROR, 0, "AsyncFileReader::thread_main() throws exception: " << e.m_errStr);
+    }
+    catch (std::exception& e)
+    {
+        LTRACE(LT_ERROR, 0, "AsyncFileReader::thread_main() throws exception: " << e.what());
+    }
+    catch (...)
+    {
+        LTRACE(LT_ERROR, 0, "AsyncFileReader::thread_main() throws unknown exception");
+    }
+}
+
+void AsyncFileReader::deleteReader(const int readerID)
+{
+    AsyncReaderData* data = getAsyncReader(readerID);
+    if (data == nullptr)
+        return;
+    {
+        std::unique_lock lk(m_readMtx);
+        waitReadDone(data, lk);
+        data->m_deleted = true;
+    }
+    std::lock_guard lock(m_readersMtx);
+    m_readers.erase(readerID);
+    delete data;
+}
+
+uint8_t* AsyncFileReader::readBlock(const int readerID, uint32_t& readCnt, int& rez, bool* firstBlockVar)
+{
+    AsyncReaderData* data = getAsyncReader(readerID);
+    if (data == nullptr)
+    {
+        rez = UNKNOWN_READERID;
+        readCnt = 0;
+        return nullptr;
+    }
+
+    std::unique_lock lk(m_readMtx);
+    if (data->m_requests.empty())
+        data->init();
+    if (data->m_delivered && !data->m_eofDelivered)
+    {
+        // the consumer is done with the previous block, give it back to the ring
+        data->headRequest().m_state = AsyncReaderData::BlockState::Free;
+        data->m_head++;
+        data->m_delivered = false;
+        if (data->m_readAhead)
+            wakeUp();
+    }
+
+    ReaderData::Block& block = data->headBlock();
+    if (data->m_eofDelivered)
+    {
+        readCnt = 0;
+        rez = DATA_EOF;
+        if (firstBlockVar)
+            *firstBlockVar = false;
+        return block.m_data;
+    }
+
+    if (data->m_head == data->m_tail && !data->m_notified)
+    {
+        data->m_notified = true;
+        wakeUp();
+    }
+    const AsyncReaderData::ReadRequest& request = data->headRequest();
+    m_readCond.wait(lk, [data, &request] {
+        return data->m_head != data->m_tail && request.m_state == AsyncReaderData::BlockState::Ready;
+    });
+    readCnt = block.m_size;
+    rez = block.m_eof ? DATA_EOF : 0;
+    if (firstBlockVar)
+        *firstBlockVar = block.m_firstBlock;
+    data->m_delivered = true;
+    data->m_eofDelivered = block.m_eof;
+    if (request.m_fd == data->m_fd)
+    {
+        data->m_deliveredPos = request.m_offset + block.m_size;
+        // the blocks before this one have been consumed
+        if (data->m_dropCache && request.m_offset > data->m_cachePos)
+        {
+            posix_fadvise(data->m_fd, data->m_cachePos, request.m_offset - data->m_cachePos, POSIX_FADV_DONTNEED);
+            data->m_cachePos = request.m_offset;
+        }
+    }
+    return block.m_data;
+}
+
+void AsyncFileReader::notify(const int readerID, const uint32_t dataReaded)
+{
+    ReaderData* data = getReader(readerID);
+    if (data == nullptr || dataReaded < m_prereadThreshold)
+        return;
+    std::lock_guard lk(m_readMtx);
+    if (!data->m_readAhead)
+    {
+        data->m_readAhead = true;
+        wakeUp();
+    }
+}
+
+void AsyncFileReader::waitReadDone(ReaderData* data, std::unique_lock<std::mutex>& lock)
+{
+    const auto asyncData = static_cast<AsyncReaderData*>(data);
+    asyncData->m_readAhead = false;
+    asyncData->m_notified = false;
+    m_readCond.wait(lock, [asyncData] { return asyncData->m_inflight == 0; });
+}
+
+bool AsyncFileReader::restartReader(AsyncReaderData* data, const int64_t newPos)
+{
+    const bool rez = data->m_fd != -1 && newPos >= 0;
+    data->resetRequests();
+    data->closeRetiredFiles();
+    if (rez)
+        data->m_deliveredPos = data->m_filePos = newPos;
+    // reading resumes on the next readBlock() call, so the stream can still be configured (file iterator, etc.)
+    return rez;
+}
+
+bool AsyncFileReader::seek(const int readerID, const int64_t offset) { return incSeek(readerID, offset); }
+
+bool AsyncFileReader::incSeek(const int readerID, const int64_t offset)
+{
+    AsyncReaderData* data = getAsyncReader(readerID);
+    if (data == nullptr)
+        return false;
+    std::unique_lock lk(m_readMtx);
+    waitReadDone(data, lk);
+    return restartReader(data, data->m_deliveredPos + offset);
+}
+
+bool AsyncFileReader::gotoByte(const int readerID, const int64_t seekDist)
+{
+    AsyncReaderData* data = getAsyncReader(readerID);
+    if (data == nullptr)
+        return false;
+    std::unique_lock lk(m_readMtx);
+    waitReadDone(data, lk);
+    data->m_blockSize = m_blockSize - static_cast<uint32_t>(seekDist % static_cast<uint64_t>(m_blockSize));
+    return restartReader(data, seekDist);
+}
+
+bool AsyncFileReader::openStream(const int readerID, const char* streamName, int pid, const CodecInfo* codecInfo)
+{
+    AsyncReaderData* data = getAsyncReader(readerID);
+    if (data == nullptr)
+    {
+        LTRACE(LT_ERROR, 0, "Unknown readerID " << readerID);
+        return false;
+    }
+    std::unique_lock lk(m_readMtx);
+    waitReadDone(data, lk);
+    data->m_firstBlock = true;
+    data->m_lastBlock = false;
+    data->m_streamName = streamName;
+    data->closeStream();
+    const bool rez = data->openStream();
+    restartReader(data, 0);
+    return rez;
+}
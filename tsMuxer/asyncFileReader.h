@@ -0,0 +1,117 @@
+#ifndef ASYNC_FILE_READER_H_
+#define ASYNC_FILE_READER_H_
+
+#include <vector>
+
+#include "bufferedReader.h"
+
+// Reader data for the io_uring based reader. The blocks of the ring are all submitted to the kernel at once, so that
+// the device sees several outstanding requests per stream.
+struct AsyncReaderData final : ReaderData
+{
+    enum class BlockState
+    {
+        Free,
+        Pending,
+        Ready
+    };
+
+    // read of the block with the same index in m_blocks
+    struct ReadRequest
+    {
+        AsyncReaderData* m_owner = nullptr;
+        int m_fd = -1;
+        int64_t m_offset = 0;
+        uint32_t m_len = 0;  // planned read size
+        BlockState m_state = BlockState::Free;
+    };
+
+    AsyncReaderData();
+    ~AsyncReaderData() override;
+
+    void init() override;
+    bool openStream() override;
+    bool closeStream() override;
+    int readBlock(uint8_t* buffer, uint32_t max_size) override;
+
+    ReadRequest& headRequest() { return m_requests[m_head % m_requests.size()]; }
+    ReadRequest& tailRequest() { return m_requests[m_tail % m_requests.size()]; }
+    void resetRequests();
+    void closeRetiredFiles();
+
+    std::vector<ReadRequest> m_requests;
+    int m_inflight;
+
+    int m_fd;
+    int64_t m_fileSize;
+    int64_t m_filePos;       // offset of the next read to submit
+    int64_t m_deliveredPos;  // offset after the last block returned to the consumer
+    int64_t m_cachePos;      // data before this offset has been dropped from the system cache
+    std::vector<int> m_retiredFiles;
+};
+
+// AbstractReader implementation which reads files through io_uring with several requests in flight per stream.
+// A single thread per reader submits reads for all registered streams and reaps their completions.
+class AsyncFileReader final : public BufferedReader
+{
+   public:
+    AsyncFileReader(uint32_t blockSize, uint32_t allocSize = 0, uint32_t prereadThreshold = 0,
+                    uint32_t readAheadDepth = ASYNC_READ_AHEAD_DEPTH);
+    ~AsyncFileReader() override;
+
+    //! Returns true if io_uring can be used on this system.
+    static bool isSupported();
+
+    void deleteReader(int readerID) override;
+    uint8_t* readBlock(int readerID, uint32_t& readCnt, int& rez, bool* firstBlockVar = nullptr) override;
+    void notify(int readerID, uint32_t dataReaded) override;
+    bool seek(int readerID, int64_t offset) override;
+    bool incSeek(int readerID, int64_t offset) override;
+    bool gotoByte(int readerID, int64_t seekDist) override;
+    bool openStream(int readerID, const char* streamName, int pid = 0, const CodecInfo* codecInfo = nullptr) override;
+
+    // default ring size: deeper than for synchronous reading, as all blocks of the ring are read in parallel
+    static constexpr uint32_t ASYNC_READ_AHEAD_DEPTH = 4;
+
+   protected:
+    ReaderData* intCreateReader() override { return new AsyncReaderData(); }
+    void thread_main() override;
+    void waitReadDone(ReaderData* data, std::unique_lock<std::mutex>& lock) override;
+
+   private:
+    bool initRing();
+    void closeRing();
+    void wakeUp() const;
+    void planReads(AsyncReaderData* data);
+    void planNextBlock(AsyncReaderData* data, AsyncReaderData::ReadRequest& request, ReaderData::Block& block) const;
+    bool submitRead(int fd, void* buffer, uint32_t len, int64_t offset, uint64_t userData);
+    void submitWakeRead();
+    void processCompletions();
+    bool restartReader(AsyncReaderData* data, int64_t newPos);
+    AsyncReaderData* getAsyncReader(int readerID);
+
+    int m_ringFd;
+    int m_wakeFd;
+    uint64_t m_wakeValue;
+    bool m_wakePending;
+    unsigned m_ringEntries;
+    int m_inflight;
+    int m_toSubmit;
+
+    void* m_sqRing;
+    size_t m_sqRingSize;
+    void* m_cqRing;
+    size_t m_cqRingSize;
+    void* m_sqes;
+    size_t m_sqesSize;
+    unsigned* m_sqHead;
+    unsigned* m_sqTail;
+    unsigned* m_sqMask;
+    unsigned* m_sqArray;
+    unsigned* m_cqHead;
+    unsigned* m_cqTail;
+    unsigned* m_cqMask;
+    void* m_cqes;
+};
+
+#endif
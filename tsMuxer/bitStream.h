@@ -5,6 +5,10 @@
 #include <limits.h>
 #include <types/types.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 static constexpr unsigned INT_BIT = CHAR_BIT * sizeof(unsigned);
 
 class BitStreamException final : public std::exception
@@ -41,17 +45,21 @@ class BitStream
         0x07ffffff, 0x0fffffff, 0x1fffffff, 0x3fffffff, 0x7fffffff, UINT_MAX};
 };
 
+// Bits are read from a 64-bit cache, refilled 8 bytes at a time. The end of the buffer is only checked when the cache
+// runs out of bits, reads which the cache can serve don't test anything else.
 class BitStreamReader : public BitStream
 {
    public:
-    BitStreamReader() : m_curVal(0), m_bitLeft(0) {}
+    BitStreamReader() : m_next(nullptr), m_end(nullptr), m_cache(0), m_cacheBits(0) {}
 
     void setBuffer(uint8_t* buffer, const uint8_t* end)
     {
         BitStream::setBuffer(buffer, end);
-        m_bitLeft = 0;
-        m_curVal = getCurVal(m_buffer);
-        m_bitLeft = INT_BIT;
+        m_next = buffer;
+        m_end = end;
+        m_cache = 0;
+        m_cacheBits = 0;
+        refill(0);
     }
 
     template <typename T>
@@ -62,117 +70,140 @@ class BitStreamReader : public BitStream
 
     [[nodiscard]] unsigned getBits(const unsigned num)
     {
-        if (num > INT_BIT || m_totalBits < num)
+        if (num > INT_BIT)
             THROW_BITSTREAM_ERR;
-        unsigned prevVal = 0;
-        if (num <= m_bitLeft)
-            m_bitLeft -= num;
-        else
-        {
-            if (m_bitLeft != 0)
-                prevVal = (m_curVal & m_masks[m_bitLeft]) << (num - m_bitLeft);
-            m_buffer++;
-            m_curVal = getCurVal(m_buffer);
-            m_bitLeft += INT_BIT - num;
-        }
-        m_totalBits -= num;
-        return prevVal + (m_curVal >> m_bitLeft) & m_masks[num];
+        if (num > m_cacheBits)
+            refill(num);
+        // two shifts: a shift by 64 is undefined when num is 0
+        const auto value = static_cast<unsigned>((m_cache >> 1) >> (63 - num));
+        consume(num);
+        return value;
     }
 
     [[nodiscard]] int showBits(const unsigned num) const
     {
-        if (num > INT_BIT - 1 || m_totalBits < num)
+        if (num > INT_BIT - 1)
             THROW_BITSTREAM_ERR;
-        unsigned prevVal = 0;
-        unsigned bitLeft = m_bitLeft;
-        unsigned curVal = m_curVal;
-        if (num <= bitLeft)
-            bitLeft -= num;
-        else
-        {
-            prevVal = (curVal & m_masks[bitLeft]) << (num - bitLeft);
-            curVal = getCurVal(m_buffer + 1);
-            bitLeft += INT_BIT - num;
-        }
-        return static_cast<int>(prevVal + (curVal >> bitLeft) & m_masks[num]);
+        if (num > m_cacheBits)
+            refill(num);
+        return static_cast<int>((m_cache >> 1) >> (63 - num));
     }
 
     [[nodiscard]] bool getBit()
     {
-        if (m_totalBits < 1)
-            THROW_BITSTREAM_ERR;
-        if (m_bitLeft > 0)
-            m_bitLeft--;
-        else
-        {
-            m_buffer++;
-            m_curVal = getCurVal(m_buffer);
-            m_bitLeft = INT_BIT - 1;
-        }
-        m_totalBits--;
-        return m_curVal >> m_bitLeft & 1;
+        if (m_cacheBits == 0)
+            refill(1);
+        const bool value = m_cache >> 63;
+        consume(1);
+        return value;
     }
 
     void skipBits(const unsigned num)
     {
-        if (m_totalBits < num)
-            THROW_BITSTREAM_ERR;
         assert(num <= INT_BIT);
-        if (num <= m_bitLeft)
-            m_bitLeft -= num;
-        else
-        {
-            m_buffer++;
-            m_curVal = getCurVal(m_buffer);
-            m_bitLeft += INT_BIT - num;
-        }
-        m_totalBits -= num;
+        if (num > m_cacheBits)
+            refill(num);
+        consume(num);
     }
 
     void skipBit()
     {
-        if (m_totalBits < 1)
-            THROW_BITSTREAM_ERR;
-        if (m_bitLeft > 0)
-            m_bitLeft--;
-        else
-        {
-            m_buffer++;
-            m_curVal = getCurVal(m_buffer);
-            m_bitLeft = INT_BIT - 1;
-        }
-        m_totalBits--;
+        if (m_cacheBits == 0)
+            refill(1);
+        consume(1);
     }
 
     void alignByte()
     {
-        const unsigned tmp = m_bitLeft & 0b111;
+        // same as the former 32-bit reader, which used the bits left in its current 32-bit word
+        const unsigned tmp = (INT_BIT - getBitsCount() % INT_BIT) & 0b111;
         if (tmp > 0)
             skipBits(8 - tmp);
     }
 
+    // ue(v) Exp-Golomb code: the leading zero bits are counted at once when the whole code is in the cache
+    [[nodiscard]] unsigned getUEGolombCode()
+    {
+        if (m_cacheBits < INT_BIT)
+            refill(0);
+        const int zeros = countLeadingZeros(m_cache);
+        if (2 * zeros < static_cast<int>(m_cacheBits))
+        {
+            const unsigned len = 2 * zeros + 1;
+            const auto value = static_cast<unsigned>((m_cache >> (64 - len)) - 1);
+            consume(len);
+            return value;
+        }
+        unsigned cnt = 0;
+        for (; !getBit(); cnt++)
+            ;
+        if (cnt > INT_BIT)
+            THROW_BITSTREAM_ERR;
+        return static_cast<unsigned>((1ULL << cnt) - 1 + getBits(cnt));
+    }
+
+    // se(v) Exp-Golomb code
+    [[nodiscard]] int getSEGolombCode()
+    {
+        const unsigned rez = getUEGolombCode();
+        if (rez % 2 == 0)
+            return -static_cast<int>(rez / 2);
+        return static_cast<int>((rez + 1) / 2);
+    }
+
     [[nodiscard]] int getBitsCount() const
     {
-        return static_cast<int>((m_buffer - m_initBuffer) * INT_BIT + INT_BIT - m_bitLeft);
+        return static_cast<int>((m_next - reinterpret_cast<const uint8_t*>(m_initBuffer)) * 8 - m_cacheBits);
     }
 
    private:
-    unsigned m_curVal;
-    unsigned m_bitLeft;
+    mutable const uint8_t* m_next;  // next byte to load in the cache
+    const uint8_t* m_end;
+    mutable uint64_t m_cache;       // the next bits of the stream, starting at the most significant bit
+    mutable unsigned m_cacheBits;   // number of valid bits in m_cache
 
-    unsigned getCurVal(unsigned* buff) const
+    static int countLeadingZeros(const uint64_t value)
     {
-        const auto tmpBuf = reinterpret_cast<uint8_t*>(buff);
-        if (m_totalBits - m_bitLeft >= 32)
-            return my_ntohl(*buff);
-        if (m_totalBits - m_bitLeft >= 24)
-            return (tmpBuf[0] << 24) + (tmpBuf[1] << 16) + (tmpBuf[2] << 8);
-        if (m_totalBits - m_bitLeft >= 16)
-            return (tmpBuf[0] << 24) + (tmpBuf[1] << 16);
-        if (m_totalBits - m_bitLeft >= 8)
-            return tmpBuf[0] << 24;
+        if (value == 0)
+            return 64;
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - static_cast<int>(index);
+#else
+        return __builtin_clzll(value);
+#endif
+    }
 
-        THROW_BITSTREAM_ERR;
+    void consume(const unsigned num)
+    {
+        m_cache <<= num;
+        m_cacheBits -= num;
+        m_totalBits -= num;
+    }
+
+    // loads as many bytes as the cache can hold, throws if less than num bits are available
+    void refill(const unsigned num) const
+    {
+        if (m_end - m_next >= 8)
+        {
+            // the bytes beyond the new cache size are stored too, they are loaded again by the next refill
+            const uint64_t data = static_cast<uint64_t>(m_next[0]) << 56 | static_cast<uint64_t>(m_next[1]) << 48 |
+                                  static_cast<uint64_t>(m_next[2]) << 40 | static_cast<uint64_t>(m_next[3]) << 32 |
+                                  static_cast<uint64_t>(m_next[4]) << 24 | static_cast<uint64_t>(m_next[5]) << 16 |
+                                  static_cast<uint64_t>(m_next[6]) << 8 | static_cast<uint64_t>(m_next[7]);
+            m_cache |= data >> m_cacheBits;
+            const unsigned bytes = (63 - m_cacheBits) >> 3;
+            m_next += bytes;
+            m_cacheBits += bytes * 8;
+        }
+        else
+        {
+            for (; m_cacheBits <= 56 && m_next < m_end; m_cacheBits += 8)
+                m_cache |= static_cast<uint64_t>(*m_next++) << (56 - m_cacheBits);
+        }
+        if (m_cacheBits < num)
+            THROW_BITSTREAM_ERR;
     }
 };
 
@@ -11,7 +11,7 @@
 
 using namespace std;
 
-uint8_t bdIndexData[] = {
+const uint8_t bdIndexData[] = {
     0x49, 0x4e, 0x44, 0x58, 0x30, 0x32, 0x30, 0x30, 0x00, 0x00, 0x00, 0x4e, 0x00, 0x00, 0x00, 0x00,  // 0x78,
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -230,7 +230,7 @@ bool writeBdMovieObjectData(const MuxerManager& muxer, AbstractOutputStream* fil
     BDMV_VersionNumber num = BDMV_VersionNumber::Version1;
     if (diskType == DiskType::BLURAY)
     {
-        num = isV3() ? BDMV_VersionNumber::Version3 : BDMV_VersionNumber::Version2;
+        num = muxer.v3Info().isV3() ? BDMV_VersionNumber::Version3 : BDMV_VersionNumber::Version2;
     }
     const auto defaultAudioIdx = muxer.getDefaultAudioTrackIdx();
     MuxerManager::SubTrackMode mode;
@@ -279,7 +279,7 @@ void BlurayHelper::close()
 }
 
 bool BlurayHelper::open(const string& dst, const DiskType dt, const int64_t diskSize, const int extraISOBlocks,
-                        const bool useReproducibleIsoHeader)
+                        const bool useReproducibleIsoHeader, const unsigned oflag)
 {
     m_dstPath = toNativeSeparators(dst);
 
@@ -290,7 +290,7 @@ bool BlurayHelper::open(const string& dst, const DiskType dt, const int64_t disk
     {
         m_isoWriter = new IsoWriter(useReproducibleIsoHeader ? IsoHeaderData::reproducible() : IsoHeaderData::normal());
         m_isoWriter->setLayerBreakPoint(0xBA7200);  // around 25Gb
-        return m_isoWriter->open(m_dstPath, diskSize, extraISOBlocks);
+        return m_isoWriter->open(m_dstPath, diskSize, extraISOBlocks, oflag);
     }
     m_dstPath = closeDirPath(m_dstPath, getDirSeparator());
     return true;
@@ -345,7 +345,11 @@ void BlurayHelper::createBluRayDirs() const
 bool BlurayHelper::writeBluRayFiles(const MuxerManager& muxer, const bool usedBlankPL, const int mplsNum,
                                     const int blankNum, const bool stereoMode) const
 {
-    int fileSize = sizeof(bdIndexData);
+    // the template is copied: the flags of a disc must not leak into the other ones muxed by the process
+    const V3Info& v3Info = muxer.v3Info();
+    uint8_t indexData[sizeof(bdIndexData)];
+    memcpy(indexData, bdIndexData, sizeof(bdIndexData));
+    int fileSize = sizeof(indexData);
     const string prefix = m_isoWriter ? "" : m_dstPath;
     AbstractOutputStream* file;
     if (m_isoWriter)
@@ -355,14 +359,14 @@ bool BlurayHelper::writeBluRayFiles(const MuxerManager& muxer, const bool usedBl
 
     if (m_dt == DiskType::BLURAY)
     {
-        if (isV3())
+        if (v3Info.isV3())
         {
-            bdIndexData[5] = '3';
+            indexData[5] = '3';
             fileSize = 0x9C;         // add 36 bytes for UHD data extension
-            bdIndexData[15] = 0x78;  // start address of UHD data extension
+            indexData[15] = 0x78;  // start address of UHD data extension
 
             // UHD data extension
-            uint8_t* V3metaData = bdIndexData + 0x78;
+            uint8_t* V3metaData = indexData + 0x78;
             static constexpr char metaData[37] =
                 "\x00\x00\x00\x20\x00\x00\x00\x18\x00\x00\x00\x01"
                 "\x00\x03\x00\x01\x00\x00\x00\x18\x00\x00\x00\x0C"
@@ -370,33 +374,33 @@ bool BlurayHelper::writeBluRayFiles(const MuxerManager& muxer, const bool usedBl
             for (int i = 0; i < 36; i++) V3metaData[i] = metaData[i];
 
             // 4K => 66/100 GB Disk, 109 MB/s Recording_Rate
-            if (is4K())
-                bdIndexData[0x94] = 0x51;
+            if (v3Info.is4K())
+                indexData[0x94] = 0x51;
             // include HDR flags
-            bdIndexData[0x96] = (V3_flags & 0x1e);
+            indexData[0x96] = (v3Info.flags() & 0x1e);
             // no HDR10 detected => SDR flag
-            if (bdIndexData[0x96] == 0)
-                bdIndexData[0x96] = 1;
+            if (indexData[0x96] == 0)
+                indexData[0x96] = 1;
         }
         else  // V2 Blu-ray
         {
-            bdIndexData[5] = '2';
+            indexData[5] = '2';
             fileSize = 0x78;
         }
     }
     else
     {
-        bdIndexData[5] = '1';
-        bdIndexData[15] = 0x78;
+        indexData[5] = '1';
+        indexData[15] = 0x78;
     }
-    bdIndexData[0x2c] = stereoMode ? 0x60 : 0;  // set initial_output_mode_preference and SS_content_exist_flag
+    indexData[0x2c] = stereoMode ? 0x60 : 0;  // set initial_output_mode_preference and SS_content_exist_flag
 
     if (!file->open((prefix + "BDMV/index.bdmv").c_str(), AbstractOutputStream::ofWrite))
     {
         delete file;
         return false;
     }
-    file->write(bdIndexData, fileSize);
+    file->write(indexData, fileSize);
     file->close();
 
     if (!file->open((prefix + "BDMV/BACKUP/index.bdmv").c_str(), File::ofWrite))
@@ -404,7 +408,7 @@ bool BlurayHelper::writeBluRayFiles(const MuxerManager& muxer, const bool usedBl
         delete file;
         return false;
     }
-    file->write(bdIndexData, fileSize);
+    file->write(indexData, fileSize);
     file->close();
 
     return writeBdMovieObjectData(muxer, file, prefix, m_dt, usedBlankPL, mplsNum, blankNum);
@@ -415,9 +419,10 @@ bool BlurayHelper::createCLPIFile(TSMuxer* muxer, int clpiNum, bool doLog) const
     static constexpr int CLPI_BUFFER_SIZE = 1024 * 1024;
     auto clpiBuffer = new uint8_t[CLPI_BUFFER_SIZE];
     CLPIParser clpiParser;
+    clpiParser.m_v3Info = &muxer->v3Info();
     string version_number;
     clpiParser.version_number[0] = '0';
-    clpiParser.version_number[1] = m_dt == DiskType::BLURAY ? (isV3() ? '3' : '2') : '1';
+    clpiParser.version_number[1] = m_dt == DiskType::BLURAY ? (muxer->v3Info().isV3() ? '3' : '2') : '1';
     clpiParser.version_number[2] = '0';
     clpiParser.version_number[3] = '0';
     clpiParser.version_number[4] = 0;
@@ -460,7 +465,7 @@ bool BlurayHelper::createCLPIFile(TSMuxer* muxer, int clpiNum, bool doLog) const
             clpiParser.TS_recording_rate = MAX_SUBMUXER_RATE / 8;
         else
         {
-            if (is4K())
+            if (muxer->v3Info().is4K())
                 clpiParser.TS_recording_rate = MAX_4K_MUXER_RATE / 8;
             else
                 clpiParser.TS_recording_rate = MAX_MAIN_MUXER_RATE / 8;
@@ -540,6 +545,7 @@ bool BlurayHelper::createMPLSFile(TSMuxer* mainMuxer, TSMuxer* subMuxer, int aut
     int bufSize = 1024 * 100;
     auto mplsBuffer = new uint8_t[bufSize];
     MPLSParser mplsParser;
+    mplsParser.m_v3Info = &mainMuxer->v3Info();
     mplsParser.m_m2tsOffset = mainMuxer->getFirstFileNum();
     mplsParser.PlayList_playback_type = 1;
     mplsParser.ref_to_STC_id = 0;
@@ -18,7 +18,7 @@ bool FileReaderData::openStream()
 {
     base_class::openStream();
 
-    const bool rez = m_file.open(m_streamName.c_str(), File::ofRead);
+    const bool rez = m_file.open(m_streamName.c_str(), m_dropCache ? File::ofRead + File::ofDropCache : File::ofRead);
 
     if (!rez)
     {
@@ -38,8 +38,8 @@ bool FileReaderData::openStream()
 }
 
 BufferedFileReader::BufferedFileReader(const uint32_t blockSize, const uint32_t allocSize,
-                                       const uint32_t prereadThreshold)
-    : BufferedReader(blockSize, allocSize, prereadThreshold)
+                                       const uint32_t prereadThreshold, const uint32_t readAheadDepth)
+    : BufferedReader(blockSize, allocSize, prereadThreshold, readAheadDepth)
 {
 }
 
@@ -52,6 +52,9 @@ bool BufferedFileReader::openStream(const int readerID, const char* streamName,
         LTRACE(LT_ERROR, 0, "Unknown readerID " << readerID);
         return false;
     }
+    std::unique_lock lk(m_readMtx);
+    waitReadDone(data, lk);
+    data->resetBlocks();
     data->m_firstBlock = true;
     data->m_lastBlock = false;
     data->m_streamName = streamName;
@@ -68,15 +71,12 @@ bool BufferedFileReader::gotoByte(const int readerID, const int64_t seekDist)
     const auto data = dynamic_cast<FileReaderData*>(getReader(readerID));
     if (data)
     {
+        std::unique_lock lk(m_readMtx);
+        waitReadDone(data, lk);
+        data->discardBlocks();
         data->m_blockSize = m_blockSize - static_cast<uint32_t>(seekDist % static_cast<uint64_t>(m_blockSize));
         const uint64_t seekRez = data->m_file.seek(seekDist + data->m_fileHeaderSize, File::SeekMethod::smBegin);
-        const bool rez = seekRez != static_cast<uint64_t>(-1);
-        if (rez)
-        {
-            data->m_eof = false;
-            data->m_notified = false;
-        }
-        return rez;
+        return seekRez != static_cast<uint64_t>(-1);
     }
     return false;
 }
@@ -45,7 +45,8 @@ struct FileReaderData final : ReaderData
 class BufferedFileReader final : public BufferedReader
 {
    public:
-    BufferedFileReader(uint32_t blockSize, uint32_t allocSize = 0, uint32_t prereadThreshold = 0);
+    BufferedFileReader(uint32_t blockSize, uint32_t allocSize = 0, uint32_t prereadThreshold = 0,
+                       uint32_t readAheadDepth = DEFAULT_READ_AHEAD_DEPTH);
 
     bool openStream(int readerID, const char* streamName, int pid = 0, const CodecInfo* codecInfo = nullptr) override;
     bool gotoByte(int readerID, int64_t seekDist) override;
@@ -3,6 +3,88 @@
 
 #include <fs/systemlog.h>
 
+#include <cassert>
+#include <new>
+
+// ------------------------- OutputBlockPool ---------------------------
+
+OutputBlockPool::OutputBlockPool(const size_t blockSize, const unsigned maxBlocks)
+    : m_blockSize((blockSize + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1)),
+      m_maxBlocks(maxBlocks),
+      m_allocated(0),
+      m_freeBlocks(maxBlocks),
+      m_releaseCnt(0),
+      m_waiters(0)
+{
+    for (auto& slot : m_freeBlocks) slot.store(nullptr, std::memory_order_relaxed);
+}
+
+OutputBlockPool::~OutputBlockPool()
+{
+    for (auto& slot : m_freeBlocks)
+        if (uint8_t* block = slot.exchange(nullptr))
+            ::operator delete[](block, std::align_val_t(BLOCK_ALIGN));
+}
+
+uint8_t* OutputBlockPool::tryAcquire()
+{
+    for (auto& slot : m_freeBlocks)
+    {
+        if (slot.load(std::memory_order_relaxed) == nullptr)
+            continue;
+        if (uint8_t* block = slot.exchange(nullptr, std::memory_order_acquire))
+            return block;
+    }
+    unsigned allocated = m_allocated.load(std::memory_order_relaxed);
+    while (allocated < m_maxBlocks)
+    {
+        if (m_allocated.compare_exchange_weak(allocated, allocated + 1, std::memory_order_relaxed))
+            return static_cast<uint8_t*>(::operator new[](m_blockSize, std::align_val_t(BLOCK_ALIGN)));
+    }
+    return nullptr;
+}
+
+uint8_t* OutputBlockPool::acquire()
+{
+    while (true)
+    {
+        const uint64_t releaseCnt = m_releaseCnt.load();
+        if (uint8_t* block = tryAcquire())
+            return block;
+        // all blocks are queued for writing: sleep until one is returned
+        std::unique_lock lk(m_waitMtx);
+        ++m_waiters;
+        m_waitCond.wait(lk, [&] { return m_releaseCnt.load() != releaseCnt; });
+        --m_waiters;
+    }
+}
+
+void OutputBlockPool::release(uint8_t* block)
+{
+    if (block == nullptr)
+        return;
+    // there are as many slots as blocks, so a free slot is always found
+    for (auto& slot : m_freeBlocks)
+    {
+        uint8_t* expected = nullptr;
+        if (slot.load(std::memory_order_relaxed) == nullptr &&
+            slot.compare_exchange_strong(expected, block, std::memory_order_release, std::memory_order_relaxed))
+        {
+            // pairs with acquire(): either the waiter sees the new count or this thread sees the waiter
+            ++m_releaseCnt;
+            if (m_waiters.load() > 0)
+            {
+                std::lock_guard lk(m_waitMtx);
+                m_waitCond.notify_all();
+            }
+            return;
+        }
+    }
+    assert(false);
+}
+
+// --------------------------- WriterData ------------------------------
+
 void WriterData::execute() const
 {
     switch (m_command)
@@ -12,15 +94,21 @@ void WriterData::execute() const
         {
             m_mainFile->write(m_buffer, m_bufferLen);
         }
-        delete[] m_buffer;
+        releaseBuffer();
         break;
     default:
         break;
     }
 }
 
-BufferedFileWriter::BufferedFileWriter() : m_terminated(false), m_writeQueue(WRITE_QUEUE_MAX_SIZE)
+void WriterData::releaseBuffer() const { m_pool->release(m_buffer); }
+
+// ------------------------ BufferedFileWriter -------------------------
+
+BufferedFileWriter::BufferedFileWriter(const unsigned maxQueueSize)
+    : m_hasNextData(false), m_terminated(false), m_writeQueue(maxQueueSize + 1)  // and the command ending the thread
 {
+    m_batch.reserve(MAX_WRITE_BATCH_SIZE);
     m_lastErrorCode = 0;
     m_nothingToExecute = true;
     run(this);
@@ -29,6 +117,8 @@ BufferedFileWriter::BufferedFileWriter() : m_terminated(false), m_writeQueue(WRI
 BufferedFileWriter::~BufferedFileWriter()
 {
     terminate();
+    if (m_hasNextData)
+        m_nextData.execute();
     while (!m_writeQueue.empty())
     {
         WriterData writerData = m_writeQueue.pop();
@@ -40,10 +130,10 @@ void BufferedFileWriter::thread_main()
 {
     while (!m_terminated)
     {
-        WriterData writerData = m_writeQueue.pop();
+        nextBatch();
         try
         {
-            writerData.execute();
+            executeBatch();
         }
         catch (std::runtime_error& e)
         {
@@ -63,8 +153,48 @@ void BufferedFileWriter::thread_main()
             m_lastErrorCode = -1;
             LTRACE(LT_ERROR, 0, "BufferedFileWriter::thread_main() throws unknown exception");
         }
-        m_nothingToExecute = m_writeQueue.empty();
+        m_nothingToExecute = !m_hasNextData && m_writeQueue.empty();
+    }
+}
+
+void BufferedFileWriter::nextBatch()
+{
+    m_batch.clear();
+    m_batch.push_back(m_hasNextData ? m_nextData : m_writeQueue.pop());
+    m_hasNextData = false;
+    const WriterData& first = m_batch.front();
+    if (first.m_command != WriterData::Commands::wdWrite || first.m_mainFile == nullptr)
+        return;
+    // take the blocks already queued for the same file, without waiting for more
+    while (m_batch.size() < MAX_WRITE_BATCH_SIZE && !m_writeQueue.empty())
+    {
+        m_nextData = m_writeQueue.pop();
+        if (m_nextData.m_command != WriterData::Commands::wdWrite || m_nextData.m_mainFile != first.m_mainFile)
+        {
+            m_hasNextData = true;
+            break;
+        }
+        m_batch.push_back(m_nextData);
+    }
+}
+
+void BufferedFileWriter::executeBatch()
+{
+    if (m_batch.size() == 1)
+    {
+        m_batch.front().execute();
+        return;
+    }
+
+    const void* buffers[MAX_WRITE_BATCH_SIZE];
+    uint32_t counts[MAX_WRITE_BATCH_SIZE];
+    for (size_t i = 0; i < m_batch.size(); ++i)
+    {
+        buffers[i] = m_batch[i].m_buffer;
+        counts[i] = static_cast<uint32_t>(m_batch[i].m_bufferLen);
     }
+    m_batch.front().m_mainFile->writev(buffers, counts, static_cast<int>(m_batch.size()));
+    for (const auto& data : m_batch) data.releaseBuffer();
 }
 
 void BufferedFileWriter::terminate()
@@ -1,14 +1,54 @@
 #ifndef BUFFERED_FILE_WRITER_H_
 #define BUFFERED_FILE_WRITER_H_
 
-#include <containers/safequeue.h>
+#include <containers/spscqueue.h>
 #include <fs/file.h>
 #include <system/terminatablethread.h>
 #include <types/types.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "avPacket.h"
 #include "vod_common.h"
 
-constexpr unsigned WRITE_QUEUE_MAX_SIZE = 400 * 1024 * 1024 / DEFAULT_FILE_BLOCK_SIZE;  // 400 Mb max queue size
+constexpr unsigned MAX_WRITE_BATCH_SIZE = 16;  // max blocks written with a single system call
+constexpr unsigned OUTPUT_BLOCK_POOL_SIZE = 256 * 1024 * 1024 / DEFAULT_FILE_BLOCK_SIZE;  // 256 Mb of output blocks
+// a file block and the data of the packet which crosses its end
+constexpr size_t OUTPUT_BLOCK_SIZE = DEFAULT_FILE_BLOCK_SIZE + MAX_AV_PACKET_SIZE + 2048;
+
+// Bounded pool of output blocks shared by the muxers and the writer thread. The blocks are aligned for direct IO and
+// are returned to the pool once written instead of being freed. Free blocks are kept in a fixed array of slots, so
+// blocks are exchanged between threads without a lock. When all blocks are in use, acquire() sleeps until the writer
+// thread returns one: the pool is the bound of the data queued for writing.
+class OutputBlockPool
+{
+   public:
+    // a memory page: the direct IO memory alignment of a disk (statx dio_mem_align) doesn't exceed it
+    static constexpr size_t BLOCK_ALIGN = 4096;
+
+    OutputBlockPool(size_t blockSize, unsigned maxBlocks);
+    ~OutputBlockPool();
+
+    [[nodiscard]] size_t blockSize() const { return m_blockSize; }
+    [[nodiscard]] unsigned maxBlocks() const { return m_maxBlocks; }
+    uint8_t* acquire();
+    void release(uint8_t* block);
+
+   private:
+    uint8_t* tryAcquire();
+
+    const size_t m_blockSize;
+    const unsigned m_maxBlocks;
+    std::atomic<unsigned> m_allocated;
+    std::vector<std::atomic<uint8_t*>> m_freeBlocks;
+    std::atomic<uint64_t> m_releaseCnt;  // number of blocks returned, acquire() waits for it to change
+    std::atomic<int> m_waiters;          // threads sleeping in acquire(), release() only takes the lock if any
+    std::mutex m_waitMtx;
+    std::condition_variable m_waitCond;
+};
 
 struct WriterData
 {
@@ -24,19 +64,21 @@ struct WriterData
     int m_bufferLen;
     AbstractOutputStream* m_mainFile;
     Commands m_command;
+    OutputBlockPool* m_pool;  // pool of m_buffer, the buffer is returned to it after writing
 
-    WriterData() : m_buffer(nullptr), m_bufferLen(0), m_mainFile(), m_command() {}
+    WriterData() : m_buffer(nullptr), m_bufferLen(0), m_mainFile(), m_command(), m_pool() {}
 
     void execute() const;
+    void releaseBuffer() const;
 };
 
 class BufferedFileWriter final : public TerminatableThread
 {
    public:
-    BufferedFileWriter();
+    //! maxQueueSize is the number of blocks which may be queued, at least the size of the pools of the blocks
+    explicit BufferedFileWriter(unsigned maxQueueSize);
     ~BufferedFileWriter() override;
     void terminate();
-    int getQueueSize() const { return static_cast<int>(m_writeQueue.size()); }
 
     bool addWriterData(const WriterData& data)
     {
@@ -53,12 +95,18 @@ class BufferedFileWriter final : public TerminatableThread
     void thread_main() override;
 
    private:
+    void nextBatch();
+    void executeBatch();
+
+    std::vector<WriterData> m_batch;  // consecutive writes to the same file
+    WriterData m_nextData;            // data popped from the queue which doesn't belong to the current batch
+    bool m_hasNextData;
     bool m_nothingToExecute;
     int m_lastErrorCode;
     std::string m_lastErrorStr;
     bool m_terminated;
 
-    WaitableSafeQueue<WriterData> m_writeQueue;
+    SpscQueue<WriterData> m_writeQueue;
 };
 
 #endif
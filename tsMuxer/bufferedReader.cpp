@@ -3,6 +3,8 @@
 
 #include <fs/systemlog.h>
 
+#include <algorithm>
+
 #include "abstractReader.h"
 #include "vod_common.h"
 
@@ -16,8 +18,37 @@ int BufferedReader::m_newReaderID = 0;
 std::mutex BufferedReader::m_genReaderMtx;
 static constexpr unsigned QUEUE_MAX_SIZE = 4096;
 
-BufferedReader::BufferedReader(const uint32_t blockSize, const uint32_t allocSize, const uint32_t prereadThreshold)
-    : m_started(false), m_terminated(false), m_readQueue(QUEUE_MAX_SIZE), m_id(0)
+// ---------------------------- ReaderData ------------------------------
+
+int64_t ReaderData::discardBlocks()
+{
+    const size_t keep = m_head + (m_delivered ? 1 : 0);
+    int64_t discarded = 0;
+    for (size_t i = keep; i < m_tail; ++i) discarded += max(m_blocks[i % m_blocks.size()].m_size, 0);
+    m_tail = keep;
+    m_eof = false;
+    m_eofDelivered = false;
+    return discarded;
+}
+
+void ReaderData::resetBlocks()
+{
+    m_head = m_tail = 0;
+    m_delivered = false;
+    m_eof = false;
+    m_eofDelivered = false;
+}
+
+// ---------------------------- BufferedReader ------------------------------
+
+BufferedReader::BufferedReader(const uint32_t blockSize, const uint32_t allocSize, const uint32_t prereadThreshold,
+                               const uint32_t readAheadDepth)
+    : m_started(false),
+      m_terminated(false),
+      m_readQueue(QUEUE_MAX_SIZE),
+      m_readAheadDepth(max<uint32_t>(readAheadDepth, 2)),
+      m_dropCache(false),
+      m_id(0)
 {
     // size of the blocks being read
     m_blockSize = blockSize;
@@ -35,39 +66,47 @@ ReaderData* BufferedReader::getReader(const int readerID)
     return itr != m_readers.end() ? itr->second : nullptr;
 }
 
-bool BufferedReader::seek(const int readerID, const int64_t offset)
+void BufferedReader::queueRead(const int readerID, ReaderData* data)
 {
-    const auto itr = m_readers.find(readerID);
-    if (itr != m_readers.end())
+    // m_readMtx must be locked by the caller
+    if (data->m_notified || data->m_eof || !data->hasFreeBlock())
+        return;
+    data->m_notified = true;
     {
-        ReaderData* data = itr->second;
-        return data->incSeek(offset);
+        std::lock_guard lock(m_readersMtx);
+        data->m_atQueue++;
     }
-    return false;
+    m_readQueue.push(readerID);
+}
+
+void BufferedReader::waitReadDone(ReaderData* data, std::unique_lock<std::mutex>& lock)
+{
+    // the stream position can't be changed while the reader thread is reading from it
+    m_readCond.wait(lock, [data] { return !data->m_reading; });
+    data->m_readAhead = false;
 }
 
+bool BufferedReader::seek(const int readerID, const int64_t offset) { return incSeek(readerID, offset); }
+
 bool BufferedReader::incSeek(const int readerID, const int64_t offset)
 {
-    std::lock_guard lock(m_readersMtx);
-    const auto itr = m_readers.find(readerID);
-    if (itr != m_readers.end())
-    {
-        ReaderData* data = itr->second;
-        const bool rez = data->incSeek(offset);
-        if (rez)
-        {
-            data->m_eof = false;
-            data->m_notified = false;
-        }
-        return rez;
-    }
-    return false;
+    ReaderData* data = getReader(readerID);
+    if (data == nullptr)
+        return false;
+    std::unique_lock lk(m_readMtx);
+    waitReadDone(data, lk);
+    // the offset is relative to the data returned to the consumer, not to the data read ahead
+    const int64_t readAhead = data->discardBlocks();
+    return data->incSeek(offset - readAhead);
 }
 
 BufferedReader::~BufferedReader()
 {
     terminate();
-    m_readQueue.push(0);
+    {
+        std::lock_guard lk(m_readMtx);
+        m_readQueue.push(0);
+    }
     join();
     for (const auto& m_reader : m_readers)
     {
@@ -90,8 +129,10 @@ int BufferedReader::createReader(const int readBuffOffset)
 
     data->m_blockSize = m_blockSize;
     data->m_allocSize = m_allocSize;
+    data->m_blocks.resize(m_readAheadDepth);
 
     data->m_readOffset = readBuffOffset;
+    data->m_dropCache = m_dropCache;
 
     data->m_firstBlock = true;
     data->m_lastBlock = false;
@@ -130,42 +171,42 @@ void BufferedReader::deleteReader(const int readerID)
 
 uint8_t* BufferedReader::readBlock(const int readerID, uint32_t& readCnt, int& rez, bool* firstBlockVar)
 {
-    ReaderData* data;
+    ReaderData* data = getReader(readerID);
+    if (data == nullptr)
     {
-        std::lock_guard lock(m_readersMtx);
-        const auto itr = m_readers.find(readerID);
-        if (itr != m_readers.end())
-        {
-            data = itr->second;
-            if (!data->m_nextBlockSize && !data->m_notified)
-            {  // No fragments of this block found, and no requests for reading this block
-                data->m_notified = true;
-                data->m_atQueue++;
-                m_readQueue.push(readerID);
-            }
-        }
-        else
-        {
-            rez = UNKNOWN_READERID;
-            readCnt = 0;
-            return nullptr;
-        }
+        rez = UNKNOWN_READERID;
+        readCnt = 0;
+        return nullptr;
+    }
+
+    std::unique_lock lk(m_readMtx);
+    if (data->m_delivered && !data->m_eofDelivered)
+    {
+        // the consumer is done with the previous block, give it back to the ring
+        data->m_head++;
+        data->m_delivered = false;
     }
 
-    if (!data->m_nextBlockSize)
+    ReaderData::Block& block = data->headBlock();
+    if (data->m_eofDelivered)
     {
-        std::unique_lock lk(m_readMtx);
-        while (data->m_nextBlockSize == 0 && !data->m_eof) m_readCond.wait(lk);
+        readCnt = 0;
+        rez = DATA_EOF;
+        if (firstBlockVar)
+            *firstBlockVar = false;
+        return block.m_data;
     }
-    readCnt = data->m_nextBlockSize >= 0 ? data->m_nextBlockSize : 0;
-    rez = data->m_eof ? DATA_EOF : NO_ERROR;
-    const uint8_t prevIndex = data->m_bufferIndex;
-    data->m_bufferIndex = 1 - data->m_bufferIndex;
-    data->m_nextBlockSize = 0;
-    data->m_notified = false;
+
+    if (data->m_head == data->m_tail || data->m_readAhead)
+        queueRead(readerID, data);
+    m_readCond.wait(lk, [data] { return data->m_head != data->m_tail; });
+    readCnt = block.m_size >= 0 ? block.m_size : 0;
+    rez = block.m_eof ? DATA_EOF : NO_ERROR;
     if (firstBlockVar)
-        *firstBlockVar = data->m_firstBlock;
-    return data->m_nextBlock[prevIndex];
+        *firstBlockVar = block.m_firstBlock;
+    data->m_delivered = true;
+    data->m_eofDelivered = block.m_eof;
+    return block.m_data;
 }
 
 void BufferedReader::terminate()
@@ -179,12 +220,11 @@ void BufferedReader::notify(const int readerID, const uint32_t dataReaded)
     ReaderData* data = getReader(readerID);
     if (data == nullptr)
         return;
-    if (dataReaded >= m_prereadThreshold && !data->m_notified)
+    if (dataReaded >= m_prereadThreshold)
     {
-        std::lock_guard lock(m_readersMtx);
-        data->m_notified = true;
-        data->m_atQueue++;
-        m_readQueue.push(readerID);
+        std::lock_guard lk(m_readMtx);
+        data->m_readAhead = true;
+        queueRead(readerID, data);
     }
 }
 
@@ -208,9 +248,20 @@ void BufferedReader::thread_main()
             ReaderData* data = getReader(readerID);
             if (data)
             {
-                uint8_t* buffer = data->m_nextBlock[data->m_bufferIndex] + data->m_readOffset;
-                if (!data->m_deleted)
+                ReaderData::Block* block = nullptr;
+                {
+                    std::lock_guard lk(m_readMtx);
+                    if (!data->m_deleted && !data->m_eof && data->hasFreeBlock())
+                    {
+                        block = &data->tailBlock();
+                        data->m_reading = true;
+                    }
+                    else
+                        data->m_notified = false;
+                }
+                if (block)
                 {
+                    uint8_t* buffer = block->m_data + data->m_readOffset;
                     int bytesReaded = data->readBlock(buffer, data->m_blockSize);
                     if (data->m_lastBlock)
                     {
@@ -222,6 +273,7 @@ void BufferedReader::thread_main()
                         data->m_firstBlock = false;
                     }
 
+                    bool eof = false;
                     if (bytesReaded <= 0 || (bytesReaded < static_cast<int>(data->m_blockSize) && data->itr))
                     {
                         if (data->itr)
@@ -240,7 +292,7 @@ void BufferedReader::thread_main()
                                         bytesReaded = data->readBlock(buffer, m_blockSize);
                                         if (bytesReaded < static_cast<int>(m_blockSize))
                                         {
-                                            data->m_eof = true;
+                                            eof = true;
                                             data->m_lastBlock = true;
                                         }
                                     }
@@ -250,25 +302,33 @@ void BufferedReader::thread_main()
                                     }
                                 }
                                 else
-                                    data->m_eof = true;
+                                    eof = true;
                             }
                         }
                         else
                         {
-                            data->m_eof = true;
+                            eof = true;
                         }
                     }
 
                     data->m_blockSize = m_blockSize;
                     if (bytesReaded == 0)
                     {
-                        data->m_eof = true;
+                        eof = true;
                     }
 
                     {
                         std::lock_guard lk(m_readMtx);
-                        data->m_nextBlockSize = bytesReaded;
-                        m_readCond.notify_one();
+                        block->m_size = bytesReaded;
+                        block->m_eof = eof;
+                        block->m_firstBlock = data->m_firstBlock;
+                        data->m_eof = eof;
+                        data->m_tail++;
+                        data->m_reading = false;
+                        data->m_notified = false;
+                        if (data->m_readAhead)
+                            queueRead(readerID, data);
+                        m_readCond.notify_all();
                     }
                 }
 
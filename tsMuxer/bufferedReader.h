@@ -1,57 +1,60 @@
 #ifndef BUFFERED_READER_H_
 #define BUFFERED_READER_H_
 
-#include <containers/safequeue.h>
+#include <containers/spscqueue.h>
 #include <system/terminatablethread.h>
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "abstractDemuxer.h"
 #include "abstractReader.h"
 
 struct ReaderData
 {
+    // One block of the read-ahead ring. Blocks [m_head, m_tail) of the ring hold data read for the consumer.
+    struct Block
+    {
+        uint8_t* m_data = nullptr;
+        int m_size = 0;
+        bool m_firstBlock = false;
+        bool m_eof = false;
+    };
+
     ReaderData()
-        : m_bufferIndex(0),
-          m_notified(false),
-          m_nextBlockSize(0),
+        : m_notified(false),
+          m_readAhead(false),
+          m_reading(false),
           m_deleted(false),
           m_firstBlock(false),
           m_lastBlock(false),
           m_eof(false),
+          m_eofDelivered(false),
+          m_delivered(false),
+          m_dropCache(false),
           m_atQueue(0),
           itr(nullptr),
+          m_head(0),
+          m_tail(0),
           m_blockSize(0),
           m_allocSize(0),
           m_readOffset(0)
     {
-        m_nextBlock[0] = nullptr;
-        m_nextBlock[1] = nullptr;
     }
 
     virtual ~ReaderData()
     {
-        // deleteNextBlocks();
-        delete[] m_nextBlock[0];
-        delete[] m_nextBlock[1];
+        for (const Block& block : m_blocks) delete[] block.m_data;
     }
-    /*
-virtual void deleteNextBlocks()
-{
-    delete [] m_nextBlock[0];
-    delete [] m_nextBlock[1];
-}
-    */
+
     virtual bool incSeek(int64_t offset) { return true; }
 
     virtual void init()
     {
-        // deleteNextBlocks();
-        if (m_nextBlock[0] == nullptr)
-            m_nextBlock[0] = new uint8_t[m_allocSize];
-        if (m_nextBlock[1] == nullptr)
-            m_nextBlock[1] = new uint8_t[m_allocSize];
+        for (Block& block : m_blocks)
+            if (block.m_data == nullptr)
+                block.m_data = new uint8_t[m_allocSize];
     }
 
     virtual bool openStream()
@@ -64,27 +67,41 @@ virtual void deleteNextBlocks()
 
     virtual bool closeStream() = 0;
 
-    uint8_t m_bufferIndex;
-    bool m_notified;
-    int m_nextBlockSize;
+    Block& headBlock() { return m_blocks[m_head % m_blocks.size()]; }
+    Block& tailBlock() { return m_blocks[m_tail % m_blocks.size()]; }
+    [[nodiscard]] bool hasFreeBlock() const { return m_tail - m_head < m_blocks.size(); }
+    // Drops the blocks read ahead but not returned to the consumer yet. Returns the amount of dropped data.
+    int64_t discardBlocks();
+    void resetBlocks();
+
+    bool m_notified;      // a read request for this stream is in the queue
+    bool m_readAhead;     // the consumer called notify(): keep the ring filled
+    bool m_reading;       // the reader thread is filling the tail block
     bool m_deleted;
     bool m_firstBlock;
     bool m_lastBlock;
-    bool m_eof;
+    bool m_eof;           // the last block has been read, nothing left to read
+    bool m_eofDelivered;  // the last block has been returned to the consumer
+    bool m_delivered;     // the head block is held by the consumer
+    bool m_dropCache;     // drop the data from the system cache once it has been read
     int m_atQueue;
     FileNameIterator* itr;
-    uint8_t* m_nextBlock[2];
+    std::vector<Block> m_blocks;
+    size_t m_head;  // block returned by (or to be returned by) the next readBlock() call
+    size_t m_tail;  // next block to read
     uint32_t m_blockSize;
     uint32_t m_allocSize;
     std::string m_streamName;
     int m_readOffset;
 };
 
-class BufferedReader : public AbstractReader, TerminatableThread
+class BufferedReader : public AbstractReader, protected TerminatableThread
 {
    public:
     static constexpr int UNKNOWN_READERID = 3;
-    BufferedReader(uint32_t blockSize, uint32_t allocSize = 0, uint32_t prereadThreshold = 0);
+    static constexpr uint32_t DEFAULT_READ_AHEAD_DEPTH = 2;
+    BufferedReader(uint32_t blockSize, uint32_t allocSize = 0, uint32_t prereadThreshold = 0,
+                   uint32_t readAheadDepth = DEFAULT_READ_AHEAD_DEPTH);
     ~BufferedReader() override;
     int createReader(int readBuffOffset = 0) override;
     void deleteReader(int readerID) override;  // unregister readed
@@ -99,6 +116,9 @@ class BufferedReader : public AbstractReader, TerminatableThread
     bool gotoByte(int readerID, int64_t seekDist) override { return false; }
 
     void setId(const uint32_t value) { m_id = value; }
+    [[nodiscard]] uint32_t getReadAheadDepth() const { return m_readAheadDepth; }
+    // applies to the streams created afterwards
+    void setDropCache(const bool value) { m_dropCache = value; }
 
    protected:
     virtual ReaderData* intCreateReader() = 0;
@@ -106,15 +126,19 @@ class BufferedReader : public AbstractReader, TerminatableThread
 
     bool m_started;
     bool m_terminated;
-    WaitableSafeQueue<int> m_readQueue;
+    SpscQueue<int> m_readQueue;  // pushes are serialized by m_readMtx
     ReaderData* getReader(int readerID);
+    void queueRead(int readerID, ReaderData* data);
+    virtual void waitReadDone(ReaderData* data, std::unique_lock<std::mutex>& lock);
     std::condition_variable m_readCond;
     std::mutex m_readMtx;
+    std::mutex m_readersMtx;
+    std::map<int, ReaderData*> m_readers;
+    uint32_t m_readAheadDepth;  // number of blocks in the ring of each stream
+    bool m_dropCache;
 
    private:
     uint32_t m_id;
-    std::mutex m_readersMtx;
-    std::map<int, ReaderData*> m_readers;
     static int m_newReaderID;
     static int createNewReaderID();
     static std::mutex m_genReaderMtx;
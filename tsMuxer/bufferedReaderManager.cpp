@@ -1,52 +1,200 @@
 #include "bufferedReaderManager.h"
 
+#include <fs/systemlog.h>
+
 #include <climits>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+#ifdef TSMUXER_IO_URING
+#include "asyncFileReader.h"
+#endif
+#ifdef TSMUXER_MMAP_READ
+#include "mmapFileReader.h"
+#endif
 
 using namespace std;
 
-BufferedReaderManager::BufferedReaderManager(const uint32_t readersCnt, const uint32_t blockSize,
-                                             const uint32_t allocSize, const uint32_t prereadThreshold)
+namespace
 {
-    init(blockSize, allocSize, prereadThreshold);
-
-    for (uint32_t i = 0; i < readersCnt; i++)
+// Returns true if the file is stored on a rotational disk, with the id of its device.
+bool getRotationalDevice(const char* fileName, uint64_t& device)
+{
+#ifdef __linux__
+    struct stat st;
+    if (stat(fileName, &st) != 0)
+        return false;
+    device = st.st_dev;
+    // partitions don't have a queue of their own, it is found on the parent device
+    const string sysPath = "/sys/dev/block/" + to_string(major(st.st_dev)) + ":" + to_string(minor(st.st_dev));
+    for (const char* queuePath : {"/queue/rotational", "/../queue/rotational"})
     {
-        BufferedReader* reader = new BufferedFileReader(blockSize, allocSize, prereadThreshold);
-        reader->setId(i);
-        m_fileReaders.push_back(reader);
+        ifstream file(sysPath + queuePath);
+        int rotational;
+        if (file >> rotational)
+            return rotational != 0;
     }
+#endif
+    // unknown device type: the file is handled as if it was on a SSD
+    return false;
+}
+}  // namespace
 
-    m_readersCnt = readersCnt;
+BufferedReaderManager::BufferedReaderManager(const uint32_t readersCnt, const uint32_t blockSize,
+                                             const uint32_t allocSize, const uint32_t prereadThreshold,
+                                             const uint32_t readAheadDepth)
+    : m_readersCnt(readersCnt), m_readMode(ReadMode::Buffered), m_dropCache(false)
+{
+    init(blockSize, allocSize, prereadThreshold, readAheadDepth);
 }
 
-void BufferedReaderManager::init(const uint32_t blockSize, const uint32_t allocSize, const uint32_t prereadThreshold)
+void BufferedReaderManager::init(const uint32_t blockSize, const uint32_t allocSize, const uint32_t prereadThreshold,
+                                 const uint32_t readAheadDepth)
 {
     m_blockSize = blockSize > 0 ? blockSize : DEFAULT_FILE_BLOCK_SIZE;
     m_allocSize = allocSize > 0 ? allocSize : m_blockSize + MAX_AV_PACKET_SIZE;
     m_prereadThreshold = prereadThreshold > 0 ? prereadThreshold : m_blockSize / 2;
+    m_readAheadDepth = readAheadDepth;
+    deleteReaders();
+    createReaders();
 }
 
-BufferedReaderManager::~BufferedReaderManager()
+void BufferedReaderManager::setReadMode(const ReadMode mode)
+{
+    if (mode == m_readMode)
+        return;
+#ifdef TSMUXER_IO_URING
+    if (mode == ReadMode::Async && !AsyncFileReader::isSupported())
+    {
+        LTRACE(LT_WARN, 2, "Warning! io_uring is not available on this system, using synchronous file reading.");
+        return;
+    }
+#else
+    if (mode == ReadMode::Async)
+    {
+        LTRACE(LT_WARN, 2, "Warning! Asynchronous file reading is not supported on this platform.");
+        return;
+    }
+#endif
+#ifndef TSMUXER_MMAP_READ
+    if (mode == ReadMode::Mmap)
+    {
+        LTRACE(LT_WARN, 2, "Warning! Memory mapped file reading is not supported on this platform.");
+        return;
+    }
+#endif
+    m_readMode = mode;
+    deleteReaders();
+    createReaders();
+}
+
+void BufferedReaderManager::setDropCache(const bool value)
+{
+    m_dropCache = value;
+    for (const auto& reader : m_fileReaders) reader->setDropCache(value);
+}
+
+BufferedReader* BufferedReaderManager::createReader(const uint32_t id) const
+{
+    BufferedReader* reader;
+    switch (m_readMode)
+    {
+#ifdef TSMUXER_IO_URING
+    case ReadMode::Async:
+        reader = new AsyncFileReader(m_blockSize, m_allocSize, m_prereadThreshold, m_readAheadDepth);
+        break;
+#endif
+#ifdef TSMUXER_MMAP_READ
+    case ReadMode::Mmap:
+        reader = new MmapFileReader(m_blockSize, m_allocSize, m_prereadThreshold, m_readAheadDepth);
+        break;
+#endif
+    default:
+        reader = new BufferedFileReader(m_blockSize, m_allocSize, m_prereadThreshold, m_readAheadDepth);
+        break;
+    }
+    reader->setId(id);
+    reader->setDropCache(m_dropCache);
+    return reader;
+}
+
+void BufferedReaderManager::createReaders()
+{
+    for (uint32_t i = 0; i < m_readersCnt; i++) m_fileReaders.push_back(createReader(i));
+}
+
+void BufferedReaderManager::deleteReaders()
 {
     for (const auto& m_fileReader : m_fileReaders)
     {
         delete m_fileReader;  // need to define destruction order first. This object MUST be deleted after
                               // MCVodStreamer
     }
+    m_fileReaders.clear();
+    m_diskReaders.clear();
 }
 
-AbstractReader* BufferedReaderManager::getReader(const char* streamName) const
+BufferedReaderManager::~BufferedReaderManager() { deleteReaders(); }
+
+vector<bool> BufferedReaderManager::dedicatedReaders() const
 {
-    uint32_t minReaderCnt = UINT_MAX;
-    uint32_t minReaderIndex = 0;
+    vector<bool> dedicated(m_fileReaders.size());
+    for (const auto& diskReader : m_diskReaders) dedicated[diskReader.second] = true;
+    return dedicated;
+}
+
+uint32_t BufferedReaderManager::addReader()
+{
+    const auto index = static_cast<uint32_t>(m_fileReaders.size());
+    m_fileReaders.push_back(createReader(index));
+    return index;
+}
 
-    for (uint32_t i = 0; i < m_readersCnt; i++)
+uint32_t BufferedReaderManager::leastLoadedReader()
+{
+    // the readers dedicated to a rotational disk are not used for other files
+    const vector<bool> dedicated = dedicatedReaders();
+    uint32_t minReaderCnt = UINT_MAX;
+    uint32_t minReaderIndex = UINT_MAX;
+    for (uint32_t i = 0; i < m_fileReaders.size(); i++)
     {
+        if (dedicated[i])
+            continue;
         if (m_fileReaders[i]->getReaderCount() < minReaderCnt)
         {
             minReaderCnt = m_fileReaders[i]->getReaderCount();
             minReaderIndex = i;
         }
     }
-    return m_fileReaders[minReaderIndex];
+    return minReaderIndex != UINT_MAX ? minReaderIndex : addReader();
+}
+
+uint32_t BufferedReaderManager::idleReader()
+{
+    const vector<bool> dedicated = dedicatedReaders();
+    for (uint32_t i = 0; i < m_fileReaders.size(); i++)
+        if (!dedicated[i] && m_fileReaders[i]->getReaderCount() == 0)
+            return i;
+    return addReader();
+}
+
+AbstractReader* BufferedReaderManager::getReader(const char* streamName)
+{
+    std::lock_guard lock(m_readersMtx);
+    uint64_t device;
+    if (streamName && *streamName && getRotationalDevice(streamName, device))
+    {
+        const auto itr = m_diskReaders.find(device);
+        if (itr != m_diskReaders.end())
+            return m_fileReaders[itr->second];
+        // a new disk: its thread must not serve the streams of other devices
+        const uint32_t index = idleReader();
+        m_diskReaders[device] = index;
+        return m_fileReaders[index];
+    }
+    return m_fileReaders[leastLoadedReader()];
 }
@@ -1,6 +1,8 @@
 #ifndef BUFFERED_READER_MANAGER_H_
 #define BUFFERED_READER_MANAGER_H_
 
+#include <map>
+#include <mutex>
 #include <vector>
 
 #include "bufferedFileReader.h"
@@ -8,23 +10,58 @@
 class BufferedReaderManager
 {
    public:
+    enum class ReadMode
+    {
+        Buffered,  // reader thread with a ring of block buffers
+        Async,     // io_uring, several reads in flight per stream
+        Mmap       // input files mapped in memory
+    };
+
     BufferedReaderManager(uint32_t readersCnt, uint32_t blockSize = 0, uint32_t allocSize = 0,
-                          uint32_t prereadThreshold = 0);
+                          uint32_t prereadThreshold = 0, uint32_t readAheadDepth = 0);
     ~BufferedReaderManager();
-    AbstractReader* getReader(const char* streamName) const;
+    // Returns the reader for a new stream. The files of a rotational disk are all read by the same reader thread, and
+    // each rotational disk gets a thread of its own: an idle one, or a new one. Other files are spread over the threads
+    // which don't serve such a disk.
+    AbstractReader* getReader(const char* streamName);
 
-    void init(uint32_t blockSize = 0, uint32_t allocSize = 0, uint32_t prereadThreshold = 0);
+    // readAheadDepth is the number of blocks buffered per stream, 0 selects the reader's default. Changing the
+    // parameters recreates the readers, so it must be done before any stream is opened.
+    void init(uint32_t blockSize = 0, uint32_t allocSize = 0, uint32_t prereadThreshold = 0,
+              uint32_t readAheadDepth = 0);
+    // Switch the way the input files are read. Must be called before any stream is opened.
+    void setReadMode(ReadMode mode);
+    [[nodiscard]] ReadMode getReadMode() const { return m_readMode; }
+    // Drop the input files from the system cache once they have been read. Must be called before any stream is opened.
+    void setDropCache(bool value);
 
     [[nodiscard]] uint32_t getBlockSize() const { return m_blockSize; }
     [[nodiscard]] uint32_t getAllocSize() const { return m_allocSize; }
     [[nodiscard]] uint32_t getPreReadThreshold() const { return m_prereadThreshold; }
+    [[nodiscard]] uint32_t getReadAheadDepth() const { return m_readAheadDepth; }
 
    private:
+    void createReaders();
+    void deleteReaders();
+    [[nodiscard]] BufferedReader* createReader(uint32_t id) const;
+    [[nodiscard]] std::vector<bool> dedicatedReaders() const;
+    uint32_t addReader();
+    // the reader with the fewest streams among the ones which don't serve a rotational disk, created if there is none
+    uint32_t leastLoadedReader();
+    // a reader without streams which doesn't serve a rotational disk, created if there is none
+    uint32_t idleReader();
+
+    // readers are added when a rotational disk finds no idle reader thread, or when all of them serve such a disk
     std::vector<BufferedReader*> m_fileReaders;
+    std::map<uint64_t, uint32_t> m_diskReaders;  // device id -> index of the reader dedicated to the disk
+    std::mutex m_readersMtx;
     uint32_t m_readersCnt;
     uint32_t m_blockSize;
     uint32_t m_allocSize;
     uint32_t m_prereadThreshold;
+    uint32_t m_readAheadDepth;
+    ReadMode m_readMode;
+    bool m_dropCache;
 };
 
 #endif
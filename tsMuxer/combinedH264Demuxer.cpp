@@ -113,7 +113,7 @@ void CombinedH264Reader::fillPids(const PIDSet& acceptedPIDs, const int pid)
 
 // --------------------------------------------- CombinedH264Demuxer ---------------------------
 
-CombinedH264Demuxer::CombinedH264Demuxer(const BufferedReaderManager& readManager, const char* streamName)
+CombinedH264Demuxer::CombinedH264Demuxer(BufferedReaderManager& readManager, const char* streamName)
     : m_readManager(readManager)
 {
     m_bufferedReader = m_readManager.getReader(streamName);
@@ -236,7 +236,7 @@ int64_t CombinedH264Demuxer::getDemuxedSize() { return m_dataProcessed; }
 
 void CombinedH264Demuxer::setFileIterator(FileNameIterator* itr)
 {
-    const auto br = dynamic_cast<BufferedFileReader*>(m_bufferedReader);
+    const auto br = dynamic_cast<BufferedReader*>(m_bufferedReader);
     if (br)
         br->setFileIterator(itr, m_readerID);
     else if (itr != nullptr)
@@ -45,7 +45,7 @@ class CombinedH264Reader
 class CombinedH264Demuxer final : public AbstractDemuxer, public CombinedH264Reader
 {
    public:
-    CombinedH264Demuxer(const BufferedReaderManager& readManager, const char* streamName);
+    CombinedH264Demuxer(BufferedReaderManager& readManager, const char* streamName);
     ~CombinedH264Demuxer() override;
     void openFile(const std::string& streamName) override;
     void readClose() override;
@@ -58,7 +58,7 @@ class CombinedH264Demuxer final : public AbstractDemuxer, public CombinedH264Rea
     [[nodiscard]] bool isPidFilterSupported() const override { return true; }
 
    private:
-    const BufferedReaderManager& m_readManager;
+    BufferedReaderManager& m_readManager;
     AbstractReader* m_bufferedReader;
     int m_readerID;
     int m_lastReadRez;
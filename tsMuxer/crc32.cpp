@@ -0,0 +1,136 @@
+#include "crc32.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32_CLMUL
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(CRC32_CLMUL) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_CLMUL __attribute__((target("pclmul,ssse3")))
+#else
+#define TARGET_CLMUL
+#endif
+
+namespace
+{
+constexpr uint32_t CRC32_POLY = 0x04c11db7;
+
+typedef std::array<std::array<uint32_t, 256>, 8> CRCTables;
+
+// tables[k][b] is the CRC of the byte b followed by k zero bytes
+constexpr CRCTables makeTables()
+{
+    CRCTables tables{};
+    for (uint32_t b = 0; b < 256; b++)
+    {
+        uint32_t crc = b << 24;
+        for (int bit = 0; bit < 8; bit++) crc = (crc & 0x80000000) ? (crc << 1) ^ CRC32_POLY : crc << 1;
+        tables[0][b] = crc;
+    }
+    for (int k = 1; k < 8; k++)
+        for (int b = 0; b < 256; b++)
+            tables[k][b] = (tables[k - 1][b] << 8) ^ tables[0][tables[k - 1][b] >> 24];
+    return tables;
+}
+
+constexpr CRCTables CRC32_TABLES = makeTables();
+
+uint32_t crc32Slicing8(const uint8_t *p_begin, uint64_t i_count, uint32_t i_crc)
+{
+    const auto &t = CRC32_TABLES;
+    for (; i_count >= 8; i_count -= 8, p_begin += 8)
+    {
+        i_crc ^= static_cast<uint32_t>(p_begin[0]) << 24 | p_begin[1] << 16 | p_begin[2] << 8 | p_begin[3];
+        i_crc = t[7][i_crc >> 24] ^ t[6][(i_crc >> 16) & 0xff] ^ t[5][(i_crc >> 8) & 0xff] ^ t[4][i_crc & 0xff] ^
+                t[3][p_begin[4]] ^ t[2][p_begin[5]] ^ t[1][p_begin[6]] ^ t[0][p_begin[7]];
+    }
+    for (; i_count > 0; i_count--) i_crc = (i_crc << 8) ^ t[0][(i_crc >> 24) ^ *p_begin++];
+    return i_crc;
+}
+
+#ifdef CRC32_CLMUL
+
+// x^n mod P
+constexpr uint64_t xPowModP(const int n)
+{
+    uint32_t rem = 1;
+    for (int i = 0; i < n; i++) rem = (rem & 0x80000000) ? (rem << 1) ^ CRC32_POLY : rem << 1;
+    return rem;
+}
+
+constexpr int FOLD_BLOCKS = 4;
+constexpr uint64_t CLMUL_MIN_SIZE = 256;
+
+TARGET_CLMUL __m128i loadBigEndian(const uint8_t *p)
+{
+    // the first byte of the block becomes the highest degree coefficients of the 128 bits polynomial
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), reverse);
+}
+
+// returns a value congruent to block * x^n mod P, with keys = {x^n mod P, x^(n + 64) mod P}
+TARGET_CLMUL __m128i fold(const __m128i block, const __m128i keys)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(block, keys, 0x00), _mm_clmulepi64_si128(block, keys, 0x11));
+}
+
+// The data is folded 4 x 128 bits at a time into 128 bits congruent to it modulo P, which are then run through the
+// tables as a 16 bytes message. The initial CRC is xored into the first 4 bytes of the data.
+TARGET_CLMUL uint32_t crc32Clmul(const uint8_t *p_begin, uint64_t i_count, const uint32_t i_crc)
+{
+    const __m128i keys512 = _mm_set_epi64x(xPowModP(512 + 64), xPowModP(512));
+    const __m128i keys128 = _mm_set_epi64x(xPowModP(128 + 64), xPowModP(128));
+
+    __m128i acc[FOLD_BLOCKS];
+    for (int i = 0; i < FOLD_BLOCKS; i++) acc[i] = loadBigEndian(p_begin + i * 16);
+    acc[0] = _mm_xor_si128(acc[0], _mm_set_epi32(static_cast<int>(i_crc), 0, 0, 0));
+    p_begin += FOLD_BLOCKS * 16;
+    i_count -= FOLD_BLOCKS * 16;
+
+    for (; i_count >= FOLD_BLOCKS * 16; i_count -= FOLD_BLOCKS * 16, p_begin += FOLD_BLOCKS * 16)
+        for (int i = 0; i < FOLD_BLOCKS; i++)
+            acc[i] = _mm_xor_si128(fold(acc[i], keys512), loadBigEndian(p_begin + i * 16));
+
+    __m128i rez = acc[0];
+    for (int i = 1; i < FOLD_BLOCKS; i++) rez = _mm_xor_si128(fold(rez, keys128), acc[i]);
+    for (; i_count >= 16; i_count -= 16, p_begin += 16) rez = _mm_xor_si128(fold(rez, keys128), loadBigEndian(p_begin));
+
+    alignas(16) uint8_t folded[16];
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    _mm_store_si128(reinterpret_cast<__m128i *>(folded), _mm_shuffle_epi8(rez, reverse));
+    return crc32Slicing8(p_begin, i_count, crc32Slicing8(folded, sizeof(folded), 0));
+}
+
+bool cpuHasClmul()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+#elif defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 1)) && (regs[2] & (1 << 9));
+#else
+    return false;
+#endif
+}
+
+#endif  // CRC32_CLMUL
+}  // namespace
+
+uint32_t calculateCRC32(const uint8_t *p_begin, const uint64_t i_count, uint32_t i_crc)
+{
+    if (i_crc == 0)
+        i_crc = 0xffffffff;
+#ifdef CRC32_CLMUL
+    static const bool useClmul = cpuHasClmul();
+    if (useClmul && i_count >= CLMUL_MIN_SIZE)
+        return crc32Clmul(p_begin, i_count, i_crc);
+#endif
+    return crc32Slicing8(p_begin, i_count, i_crc);
+}
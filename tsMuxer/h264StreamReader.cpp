@@ -3,6 +3,7 @@
 #include <fs/systemlog.h>
 
 #include "avCodecs.h"
+#include "tsMuxer.h"
 #include "tsPacket.h"
 #include "vodCoreException.h"
 #include "vod_common.h"
@@ -446,7 +447,8 @@ int H264StreamReader::getTSDescriptor(uint8_t *dstBuff, bool blurayMode, const b
 
         uint8_t video_format, frame_rate_index, aspect_ratio_index;
         M2TSStreamInfo::blurayStreamParams(getFPS(), getInterlaced(), getStreamWidth(), getStreamHeight(),
-                                           getStreamAR(), &video_format, &frame_rate_index, &aspect_ratio_index);
+                                           getStreamAR(), m_v3Info->isV3(), &video_format, &frame_rate_index,
+                                           &aspect_ratio_index);
         *dstBuff++ = !m_mvcSubStream ? static_cast<uint8_t>(StreamType::VIDEO_H264)
                                      : static_cast<uint8_t>(StreamType::VIDEO_MVC);  // stream_coding_type
         *dstBuff++ = static_cast<uint8_t>(video_format << 4 | frame_rate_index);     // video_format + frame_rate
@@ -1058,8 +1060,16 @@ int H264StreamReader::deserializeSliceHeader(SliceUnit &slice, const uint8_t *bu
         uint8_t *tmpBuffer = m_decodedSliceHeader.data();
         const int tmpBufferSize = static_cast<int>(m_decodedSliceHeader.size());
         toDecode = FFMIN(tmpBufferSize - 8, maxHeaderSize);
-        const int decodedLen = SliceUnit::decodeNAL(buff, buff + toDecode, tmpBuffer, tmpBufferSize);
-        nalRez = slice.deserialize(tmpBuffer, tmpBuffer + decodedLen, m_spsMap, m_ppsMap);
+        if (SliceUnit::needDecoding(buff, buff + toDecode))
+        {
+            const int decodedLen = SliceUnit::decodeNAL(buff, buff + toDecode, tmpBuffer, tmpBufferSize);
+            nalRez = slice.deserialize(tmpBuffer, tmpBuffer + decodedLen, m_spsMap, m_ppsMap);
+        }
+        else  // no emulation prevention byte: the header is parsed in place
+        {
+            const auto header = const_cast<uint8_t *>(buff);
+            nalRez = slice.deserialize(header, header + toDecode, m_spsMap, m_ppsMap);
+        }
         if (nalRez == NOT_ENOUGH_BUFFER && toDecode < maxHeaderSize)
             m_decodedSliceHeader.resize(m_decodedSliceHeader.size() + 1);
     } while (nalRez == NOT_ENOUGH_BUFFER && toDecode < maxHeaderSize);
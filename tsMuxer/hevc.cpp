@@ -17,23 +17,9 @@ unsigned ceilDiv(const unsigned a, const unsigned b) { return (a / b) + ((a % b)
 
 // ------------------------- HevcUnit -------------------
 
-unsigned HevcUnit::extractUEGolombCode()
-{
-    unsigned cnt = 0;
-    for (; !m_reader.getBit(); cnt++)
-        ;
-    if (cnt > INT_BIT)
-        THROW_BITSTREAM_ERR;
-    return (1 << cnt) - 1 + m_reader.getBits(cnt);
-}
+unsigned HevcUnit::extractUEGolombCode() { return m_reader.getUEGolombCode(); }
 
-int HevcUnit::extractSEGolombCode()
-{
-    const unsigned rez = extractUEGolombCode();
-    if (rez % 2 == 0)
-        return -static_cast<int>(rez / 2);
-    return static_cast<int>((rez + 1) / 2);
-}
+int HevcUnit::extractSEGolombCode() { return m_reader.getSEGolombCode(); }
 
 void HevcUnit::decodeBuffer(const uint8_t* buffer, const uint8_t* end)
 {
@@ -534,8 +520,6 @@ int HevcSpsUnit::deserialize()
         pic_height_in_luma_samples = extractUEGolombCode();
         if (pic_height_in_luma_samples == 0)
             return 1;
-        if (pic_width_in_luma_samples >= 3840)
-            V3_flags |= FOUR_K;
 
         if (m_reader.getBit())  // conformance_window_flag
         {
@@ -706,7 +690,7 @@ int HevcPpsUnit::deserialize()
 // ----------------------- HevcHdrUnit ------------------------
 HevcHdrUnit::HevcHdrUnit() : isHDR10(false), isHDR10plus(false), isDVRPU(false), isDVEL(false) {}
 
-int HevcHdrUnit::deserialize()
+int HevcHdrUnit::deserialize(V3Info& v3Info)
 {
     const int rez = HevcUnit::deserialize();
     if (rez)
@@ -737,24 +721,21 @@ int HevcHdrUnit::deserialize()
             if (payloadType == 137 && !isHDR10)  // mastering_display_colour_volume
             {
                 isHDR10 = true;
-                V3_flags |= HDR10;
-                HDR10_metadata[0] = m_reader.getBits(32);  // display_primaries Green
-                HDR10_metadata[1] = m_reader.getBits(32);  // display_primaries Red
-                HDR10_metadata[2] = m_reader.getBits(32);  // display_primaries Blue
-                HDR10_metadata[3] = m_reader.getBits(32);  // White Point
-                HDR10_metadata[4] = ((m_reader.getBits(32) / 10000) << 16) +
-                                    m_reader.getBits(32);  // max & min display_mastering_luminance
+                v3Info.addFlags(HDR10);
+                std::array<unsigned, 5> metadata;
+                metadata[0] = m_reader.getBits(32);  // display_primaries Green
+                metadata[1] = m_reader.getBits(32);  // display_primaries Red
+                metadata[2] = m_reader.getBits(32);  // display_primaries Blue
+                metadata[3] = m_reader.getBits(32);  // White Point
+                metadata[4] = ((m_reader.getBits(32) / 10000) << 16) +
+                              m_reader.getBits(32);  // max & min display_mastering_luminance
+                v3Info.setMasteringDisplay(metadata);
             }
             else if (payloadType == 144)  // content_light_level_info
             {
-                auto maxCLL = m_reader.getBits<uint32_t>(16);
-                auto maxFALL = m_reader.getBits<uint32_t>(16);
-                if (maxCLL > (HDR10_metadata[5] >> 16) || maxFALL > (HDR10_metadata[5] & 0x0000ffff))
-                {
-                    maxCLL = (std::max)(maxCLL, HDR10_metadata[5] >> 16);
-                    maxFALL = (std::max)(maxFALL, HDR10_metadata[5] & 0xffff);
-                    HDR10_metadata[5] = (maxCLL << 16) + maxFALL;
-                }
+                const auto maxCLL = m_reader.getBits<uint32_t>(16);
+                const auto maxFALL = m_reader.getBits<uint32_t>(16);
+                v3Info.addContentLightLevel(maxCLL, maxFALL);
             }
             else if (payloadType == 4 && payloadSize >= 8 && !isHDR10plus)
             {                           // HDR10Plus Metadata
@@ -767,7 +748,7 @@ int HevcHdrUnit::deserialize()
                 if (application_identifier == 4 && application_version == 1 && num_windows == 1)
                 {
                     isHDR10plus = true;
-                    V3_flags |= HDR10PLUS;
+                    v3Info.addFlags(HDR10PLUS);
                 }
                 payloadSize -= 8;
                 for (unsigned i = 0; i < payloadSize; i++) m_reader.skipBits(8);
@@ -3,6 +3,8 @@
 
 #include "nalUnits.h"
 
+class V3Info;
+
 struct HevcUnit
 {
     HevcUnit() : nal_unit_type(), nuh_layer_id(0), nuh_temporal_id_plus1(0), m_nalBuffer(nullptr), m_nalBufferLen(0) {}
@@ -148,7 +150,8 @@ struct HevcPpsUnit : HevcUnit
 struct HevcHdrUnit : HevcUnit
 {
     HevcHdrUnit();
-    int deserialize();
+    //! The HDR flags and metadata found are added to v3Info
+    int deserialize(V3Info& v3Info);
 
     bool isHDR10;
     bool isHDR10plus;
@@ -74,6 +74,8 @@ CheckStreamRez HEVCStreamReader::checkStream(uint8_t* buffer, const int len)
             m_sps->decodeBuffer(nal, nextNal);
             if (m_sps->deserialize() != 0)
                 return rez;
+            if (m_sps->pic_width_in_luma_samples >= 3840)
+                m_v3Info->addFlags(FOUR_K);
             m_spsPpsFound = true;
             updateFPS(m_sps, nal, nextNal, 0);
             break;
@@ -86,7 +88,7 @@ CheckStreamRez HEVCStreamReader::checkStream(uint8_t* buffer, const int len)
             break;
         case HevcUnit::NalType::SEI_PREFIX:
             m_hdr->decodeBuffer(nal, nextNal);
-            if (m_hdr->deserialize() != 0)
+            if (m_hdr->deserialize(*m_v3Info) != 0)
                 return rez;
             break;
         case HevcUnit::NalType::DVRPU:
@@ -97,7 +99,7 @@ CheckStreamRez HEVCStreamReader::checkStream(uint8_t* buffer, const int len)
                     m_hdr->isDVEL = true;
                 else
                     m_hdr->isDVRPU = true;
-                V3_flags |= DV;
+                m_v3Info->addFlags(DV);
             }
             break;
         default:
@@ -124,7 +126,7 @@ CheckStreamRez HEVCStreamReader::checkStream(uint8_t* buffer, const int len)
             m_sps->matrix_coeffs == 9)  // SMPTE.ST.2084 (PQ)
         {
             m_hdr->isHDR10 = true;
-            V3_flags |= HDR10;
+            m_v3Info->addFlags(HDR10);
         }
 
         rez.codecInfo = hevcCodecInfo;
@@ -169,7 +171,8 @@ int HEVCStreamReader::getTSDescriptor(uint8_t* dstBuff, const bool blurayMode, c
         *dstBuff++ = static_cast<uint8_t>(StreamType::VIDEO_H265);  // stream_conding_type
         uint8_t video_format, frame_rate_index, aspect_ratio_index;
         M2TSStreamInfo::blurayStreamParams(getFPS(), getInterlaced(), getStreamWidth(), getStreamHeight(),
-                                           getStreamAR(), &video_format, &frame_rate_index, &aspect_ratio_index);
+                                           getStreamAR(), m_v3Info->isV3(), &video_format, &frame_rate_index,
+                                           &aspect_ratio_index);
 
         *dstBuff++ = static_cast<uint8_t>(video_format << 4 | frame_rate_index);
         *dstBuff++ = static_cast<uint8_t>(aspect_ratio_index << 4 | 0xf);
@@ -233,14 +236,14 @@ int HEVCStreamReader::getTSDescriptor(uint8_t* dstBuff, const bool blurayMode, c
 
 int HEVCStreamReader::setDoViDescriptor(uint8_t* dstBuff) const
 {
-    const bool isDVBL = (V3_flags & BL_TRACK) == 0;
+    const bool isDVBL = (m_v3Info->flags() & BL_TRACK) == 0;
     if (!isDVBL)
         m_hdr->isDVEL = true;
 
     unsigned width = getStreamWidth();
     auto pixelRate = static_cast<uint32_t>(width * getStreamHeight() * getFPS());
 
-    if (!isDVBL && V3_flags & FOUR_K)
+    if (!isDVBL && m_v3Info->is4K())
     {
         width *= 2;
         pixelRate *= 4;
@@ -295,7 +298,7 @@ int HEVCStreamReader::setDoViDescriptor(uint8_t* dstBuff) const
             default:  // unspecified, assumed DV IPT
                 profile = 5;
                 compatibility = 0;
-                V3_flags |= BL_NOTCOMPAT;
+                m_v3Info->addFlags(BL_NOTCOMPAT);
             }
         }
     }
@@ -568,6 +571,8 @@ int HEVCStreamReader::intDecodeNAL(uint8_t* buff)
                 rez = m_sps->deserialize();
                 if (rez)
                     return rez;
+                if (m_sps->pic_width_in_luma_samples >= 3840)
+                    m_v3Info->addFlags(FOUR_K);
                 m_spsPpsFound = true;
                 updateFPS(m_sps, curPos, nextNalWithStartCode, 0);
                 storeBuffer(m_spsBuffer, curPos, nextNalWithStartCode);
@@ -584,7 +589,7 @@ int HEVCStreamReader::intDecodeNAL(uint8_t* buff)
                 break;
             case HevcUnit::NalType::SEI_PREFIX:
                 m_hdr->decodeBuffer(curPos, nextNal);
-                if (m_hdr->deserialize() != 0)
+                if (m_hdr->deserialize(*m_v3Info) != 0)
                     return rez;
                 break;
             default:
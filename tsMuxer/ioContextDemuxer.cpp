@@ -29,11 +29,11 @@ float av_int2flt(const uint32_t v)
                  static_cast<int>(v >> 23 & 0xFF) - 150);
 }
 
-IOContextDemuxer::IOContextDemuxer(const BufferedReaderManager& readManager)
+IOContextDemuxer::IOContextDemuxer(BufferedReaderManager& readManager, const char* streamName)
     : tracks(), m_readManager(readManager), m_lastReadRez(0)
 {
     m_lastProcessedBytes = 0;
-    m_bufferedReader = m_readManager.getReader("");
+    m_bufferedReader = m_readManager.getReader(streamName);
     m_readerID = m_bufferedReader->createReader(TS_FRAME_SIZE);
     m_curPos = m_bufEnd = nullptr;
     m_processedBytes = 0;
@@ -78,7 +78,7 @@ bool IOContextDemuxer::url_fseek(const int64_t offset)
     m_curPos = m_bufEnd = nullptr;
     m_isEOF = false;
     m_processedBytes = offset;
-    return dynamic_cast<BufferedFileReader*>(m_bufferedReader)->gotoByte(m_readerID, offset);
+    return m_bufferedReader->gotoByte(m_readerID, offset);
 }
 
 unsigned IOContextDemuxer::get_buffer(uint8_t* binary, unsigned size)
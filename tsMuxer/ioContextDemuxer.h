@@ -87,7 +87,7 @@ struct Track
 class IOContextDemuxer : public AbstractDemuxer
 {
    public:
-    IOContextDemuxer(const BufferedReaderManager& readManager);
+    IOContextDemuxer(BufferedReaderManager& readManager, const char* streamName = "");
     ~IOContextDemuxer() override;
     void setFileIterator(FileNameIterator* itr) override;
     int64_t getDemuxedSize() override;
@@ -99,7 +99,7 @@ class IOContextDemuxer : public AbstractDemuxer
     Track* tracks[MAX_STREAMS];
     int num_tracks;
 
-    const BufferedReaderManager& m_readManager;
+    BufferedReaderManager& m_readManager;
     AbstractReader* m_bufferedReader;
     int m_readerID;
     int m_lastReadRez;
@@ -612,10 +612,11 @@ void IsoWriter::setVolumeLabel(const std::string &value)
         m_volumeLabel = "Blu-Ray";
 }
 
-bool IsoWriter::open(const std::string &fileName, const int64_t diskSize, const int extraISOBlocks)
+bool IsoWriter::open(const std::string &fileName, const int64_t diskSize, const int extraISOBlocks,
+                     const unsigned oflag)
 {
     constexpr int systemFlags = 0;
-    if (!m_file.open(fileName.c_str(), File::ofWrite, systemFlags))
+    if (!m_file.open(fileName.c_str(), oflag, systemFlags))
         return false;
 
     if (diskSize > 0)
@@ -623,6 +624,8 @@ bool IsoWriter::open(const std::string &fileName, const int64_t diskSize, const
         const int blocks =
             2 + extraISOBlocks + static_cast<int>(roundUp64(diskSize, META_BLOCK_PER_DATA) / META_BLOCK_PER_DATA);
         setMetaPartitionSize(ALLOC_BLOCK_SIZE * blocks);
+        // TS packet and PES headers add a few percent to the size of the source streams
+        m_file.preallocate(diskSize + diskSize / 8);
     }
 
     // 1. write 32K empty space
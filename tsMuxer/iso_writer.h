@@ -183,7 +183,7 @@ class IsoWriter
     ~IsoWriter();
 
     void setVolumeLabel(const std::string& value);
-    bool open(const std::string& fileName, int64_t diskSize, int extraISOBlocks);
+    bool open(const std::string& fileName, int64_t diskSize, int extraISOBlocks, unsigned oflag = File::ofWrite);
 
     bool createDir(const std::string& dir);
     ISOFile* createFile();
@@ -1,8 +1,16 @@
 #include <fs/directory.h>
 #include <fs/systemlog.h>
 #include <fs/textfile.h>
+#include <system/terminatablethread.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <cmath>
@@ -40,7 +48,7 @@ static constexpr char EXCEPTION_ERR_MSG[] =
     }
 DiskType checkBluRayMux(const char* metaFileName, int& autoChapterLen, vector<double>& customChaptersList,
                         int& firstMplsOffset, int& firstM2tsOffset, bool& insertBlankPL, int& blankNum,
-                        bool& stereoMode, std::string& isoDiskLabel)
+                        bool& stereoMode, std::string& isoDiskLabel, V3Info& v3Info)
 {
     autoChapterLen = 0;
     stereoMode = false;
@@ -92,7 +100,7 @@ DiskType checkBluRayMux(const char* metaFileName, int& autoChapterLen, vector<do
             }
 
             if (str.find("--blu-ray-v3") != string::npos)
-                V3_flags |= HDMV_V3;
+                v3Info.addFlags(HDMV_V3);
 
             if (str.find("--blu-ray") != string::npos)
                 result = DiskType::BLURAY;
@@ -109,9 +117,64 @@ DiskType checkBluRayMux(const char* metaFileName, int& autoChapterLen, vector<do
     return result;
 }
 
-void detectStreamReader(const char* fileName, MPLSParser* mplsParser, bool isSubMode)
+// Settings of the input readers, set by the MUXOPT line of a meta file
+struct ReaderSettings
 {
-    DetectStreamRez streamInfo = METADemuxer::DetectStreamReader(readManager, fileName, mplsParser == nullptr);
+    BufferedReaderManager::ReadMode readMode = BufferedReaderManager::ReadMode::Buffered;
+    bool dropCache = false;
+    uint32_t readAheadDepth = 0;
+
+    bool operator!=(const ReaderSettings& other) const
+    {
+        return readMode != other.readMode || dropCache != other.dropCache || readAheadDepth != other.readAheadDepth;
+    }
+};
+
+ReaderSettings getReaderSettings(const char* metaFileName)
+{
+    ReaderSettings settings;
+    TextFile file(metaFileName, File::ofRead);
+    string str;
+    file.readLine(str);
+    while (str.length() > 0)
+    {
+        if (strStartWith(str, "MUXOPT"))
+        {
+            vector<string> params = splitQuotedStr(str.c_str(), ' ');
+            for (const auto& param : params)
+            {
+                vector<string> paramPair = splitStr(trimStr(param).c_str(), '=');
+                if (paramPair.empty())
+                    continue;
+                if (paramPair[0] == "--async-read")
+                    settings.readMode = BufferedReaderManager::ReadMode::Async;
+                else if (paramPair[0] == "--mmap-read")
+                    settings.readMode = BufferedReaderManager::ReadMode::Mmap;
+                else if (paramPair[0] == "--drop-cache")
+                    settings.dropCache = true;
+                else if (paramPair[0] == "--read-ahead" && paramPair.size() > 1)
+                    settings.readAheadDepth = strToInt32u(paramPair[1].c_str());
+            }
+        }
+        file.readLine(str);
+    }
+    return settings;
+}
+
+// The readers are recreated: no stream may be open
+void setupReadManager(const ReaderSettings& settings)
+{
+    readManager.setReadMode(settings.readMode);
+    readManager.setDropCache(settings.dropCache);
+    if (settings.readAheadDepth != readManager.getReadAheadDepth())
+        readManager.init(readManager.getBlockSize(), readManager.getAllocSize(), readManager.getPreReadThreshold(),
+                         settings.readAheadDepth);
+}
+
+void detectStreamReader(const char* fileName, MPLSParser* mplsParser, bool isSubMode, V3Info& v3Info)
+{
+    DetectStreamRez streamInfo =
+        METADemuxer::DetectStreamReader(readManager, fileName, mplsParser == nullptr, v3Info);
     vector<CheckStreamRez>& streams = streamInfo.streams;
 
     for (unsigned i = 0; i < streams.size(); i++)
@@ -230,7 +293,8 @@ string getBlurayStreamDir(const string& mplsName)
     return "";
 }
 
-void muxBlankPL(const string& appDir, BlurayHelper& blurayHelper, const PIDListMap& pidList, DiskType dt, int blankNum)
+void muxBlankPL(const string& appDir, BlurayHelper& blurayHelper, const PIDListMap& pidList, DiskType dt, int blankNum,
+                V3Info& v3Info, bool reportProgress, OutputBlockPool* outputBlockPool)
 {
     unsigned videoWidth = 1920;
     unsigned videoHeight = 1080;
@@ -274,7 +338,10 @@ void muxBlankPL(const string& appDir, BlurayHelper& blurayHelper, const PIDListM
     auto fname_time = std::chrono::duration_cast<std::chrono::microseconds>(
                           std::chrono::high_resolution_clock::now().time_since_epoch())
                           .count();
-    string tmpFileName = appDir + string("blank_") + std::to_string(fname_time) + string(".264");
+    // the jobs of a batch may create their blank files at the same time
+    static std::atomic<int> blankFileCnt = 0;
+    string tmpFileName = appDir + string("blank_") + std::to_string(fname_time) + string("_") +
+                         std::to_string(blankFileCnt++) + string(".264");
     File file;
     if (!file.open(tmpFileName.c_str(), File::ofWrite))
         THROW(ERR_COMMON, "can't create file " << tmpFileName)
@@ -291,7 +358,8 @@ void muxBlankPL(const string& appDir, BlurayHelper& blurayHelper, const PIDListM
     videoParams["insertSEI"];
     videoParams["fps"] = "23.976";
     {
-        MuxerManager muxerManager(readManager, tsMuxerFactory);
+        MuxerManager muxerManager(readManager, tsMuxerFactory, v3Info, outputBlockPool);
+        muxerManager.setReportProgress(reportProgress);
         muxerManager.parseMuxOpt("MUXOPT --no-pcr-on-video-pid --vbr --avchd --vbv-len=500");
         muxerManager.addStream("V_MPEG4/ISO/AVC", tmpFileName, videoParams);
         string dstFile = blurayHelper.m2tsFileName(blankNum);
@@ -334,12 +402,24 @@ tsMuxeR does not use external filters (codecs).
 Examples:
     tsMuxeR <media file name>
     tsMuxeR <meta file name> <out file/dir name>
+    tsMuxeR --batch[=<number of jobs>] <job list file name>
 
 tsMuxeR can be run in track detection mode or muxing mode. If tsMuxeR is run
 with only one argument, then the program displays track information required to
 construct a meta file. When running with two arguments, tsMuxeR starts the
 muxing or demuxing process.
 
+With --batch, tsMuxeR runs the jobs of a job list in a single process, several
+jobs at once: --batch=<number of jobs>, a quarter of the CPU threads by default.
+Each line of the job list holds a meta file name and an out file/dir
+name, separated by a space; names containing spaces must be enclosed in quotes.
+Empty lines and lines beginning with # are ignored. The jobs share the input
+reader threads, with a single thread per hard disk, so that they don't compete
+for the disks as separate tsMuxeR processes would. All jobs must use the same
+reader options. Jobs are only started while their threads don't exceed the CPU
+threads, and they share a single output buffer. A failed job doesn't stop the
+batch.
+
 Meta file format:
 File MUST have the .meta extension and be encoded in UTF-8 (but see README.md).
 This file defines the files you want to multiplex.
@@ -498,6 +578,24 @@ All parameters in this group start with two dashes:
                       also disables the FILE_FLAG_NO_BUFFERING flag on Windows
                       when writing.
                       This option is deprecated.
+--direct-io           Write the  output file  bypassing  the  system  cache
+                      (O_DIRECT), so that  writing  a large  file  does  not
+                      evict the input files from the cache. Used for TS/M2TS
+                      and ISO output. Ignored if the file  system  does  not
+                      support it. Not available on Windows.
+--async-read          Read the input files through io_uring, keeping several
+                      read requests in flight for every stream. Linux only, the
+                      default reader is used if io_uring is not available.
+--mmap-read           Map the input files in memory instead of reading them into
+                      buffers. Not available on Windows.
+--read-ahead          Number of  input  blocks  buffered  for  every  stream. A
+                      deeper  read-ahead  smooths  reading  when  some  tracks
+                      are consumed in bursts. The default value is 2, or 4 with
+                      --async-read.
+--drop-cache          Drop the input files and the TS/M2TS or ISO output from
+                      the system cache once they have been read or written, so
+                      that a large mux does not evict the data of other
+                      processes from the cache. Not available on Windows.
 --auto-chapters       Insert a chapter every <n> minutes. Used only in BD/AVCHD
                       mode.
 --custom-chapters     A semicolon delimited list of hh:mm:ss.zzz strings,
@@ -545,6 +643,389 @@ All parameters in this group start with two dashes:
     LTRACE(LT_INFO, 2, help);
 }
 
+// Muxes or demuxes the tracks of a meta file. Errors are reported by exceptions. batchPool is set in batch mode: the
+// job runs concurrently with other ones, the reader settings are set by the batch, the output blocks are taken from
+// the pool of the batch and the progress is not shown.
+void muxMetaFile(const char* appName, const char* metaFileName, const char* outName, OutputBlockPool* batchPool)
+{
+    const bool batchMode = batchPool != nullptr;
+    V3Info v3Info;
+    int firstMplsOffset = 0;
+    int firstM2tsOffset = 0;
+    int blankNum = 1900;
+    bool insertBlankPL = false;
+
+    string fileExt = extractFileExt(outName);
+    fileExt = strToUpperCase(fileExt);
+    auto startTime = std::chrono::steady_clock::now();
+
+    int autoChapterLen = 0;
+    vector<double> customChapterList;
+    bool stereoMode = false;
+    string isoDiskLabel;
+    if (!batchMode)
+        setupReadManager(getReaderSettings(metaFileName));
+    DiskType dt = checkBluRayMux(metaFileName, autoChapterLen, customChapterList, firstMplsOffset, firstM2tsOffset,
+                                 insertBlankPL, blankNum, stereoMode, isoDiskLabel, v3Info);
+    std::string fileExt2 = unquoteStr(fileExt);
+    bool muxMode =
+        fileExt2 == "M2TS" || fileExt2 == "TS" || fileExt2 == "SSIF" || fileExt2 == "ISO" || dt != DiskType::NONE;
+
+    if (muxMode)
+    {
+        BlurayHelper blurayHelper;
+
+        MuxerManager muxerManager(readManager, tsMuxerFactory, v3Info, batchPool);
+        muxerManager.setReportProgress(!batchMode);
+        muxerManager.setAllowStereoMux(fileExt2 == "SSIF" || dt != DiskType::NONE);
+        muxerManager.openMetaFile(metaFileName);
+        if (!v3Info.isV3() && dt == DiskType::BLURAY && muxerManager.getHevcFound())
+        {
+            LTRACE(LT_INFO, 2, "HEVC stream detected: changing Blu-Ray version to V3.");
+            v3Info.addFlags(HDMV_V3);
+        }
+
+        // output path - is checked for invalid characters on our platform
+        string dstFile = unquoteStr(outName);
+
+        if (!isValidFileName(dstFile))
+            throw runtime_error(string("Output filename is invalid: ") + dstFile);
+
+        if (dt != DiskType::NONE)
+        {
+            if (!blurayHelper.open(dstFile, dt, muxerManager.totalSize(), muxerManager.getExtraISOBlocks(),
+                                   muxerManager.useReproducibleIsoHeader(), muxerManager.getOutputFileFlags()))
+                throw runtime_error(string("Can't create output file ") + dstFile);
+            blurayHelper.setVolumeLabel(isoDiskLabel);
+            blurayHelper.createBluRayDirs();
+            dstFile = blurayHelper.m2tsFileName(firstM2tsOffset);
+        }
+        if (muxerManager.getTrackCnt() == 0)
+            THROW(ERR_COMMON, "No tracks selected")
+        muxerManager.doMux(dstFile, dt != DiskType::NONE ? &blurayHelper : nullptr);
+        if (dt != DiskType::NONE)
+        {
+            blurayHelper.writeBluRayFiles(muxerManager, insertBlankPL, firstMplsOffset, blankNum, stereoMode);
+            auto mainMuxer = dynamic_cast<TSMuxer*>(muxerManager.getMainMuxer());
+            auto subMuxer = dynamic_cast<TSMuxer*>(muxerManager.getSubMuxer());
+
+            if (mainMuxer)
+                blurayHelper.createCLPIFile(mainMuxer, mainMuxer->getFirstFileNum(), true);
+            if (subMuxer)
+            {
+                blurayHelper.createCLPIFile(subMuxer, subMuxer->getFirstFileNum(), false);
+
+                IsoWriter* IsoWriter = blurayHelper.isoWriter();
+                if (IsoWriter)
+                {
+                    for (size_t i = 0; i < mainMuxer->splitFileCnt(); ++i)
+                    {
+                        string file1 = mainMuxer->getFileNameByIdx(i);
+                        string file2 = subMuxer->getFileNameByIdx(i);
+                        int ssifNum = strToInt32(extractFileName(file1));
+                        if (!file1.empty() && !file2.empty())
+                            IsoWriter->createInterleavedFile(file1, file2, blurayHelper.ssifFileName(ssifNum));
+                    }
+                }
+            }
+
+            for (auto& i : customChapterList)
+                i -= static_cast<double>(muxerManager.getCutStart()) / INTERNAL_PTS_FREQ;
+
+            if (subMuxer)
+                mainMuxer->alignPTS(subMuxer);
+
+            blurayHelper.createMPLSFile(mainMuxer, subMuxer, autoChapterLen, customChapterList, dt, firstMplsOffset,
+                                        muxerManager.isMvcBaseViewR());
+
+            if (insertBlankPL && mainMuxer && !subMuxer)
+            {
+                LTRACE(LT_INFO, 2, "Adding blank play list");
+                muxBlankPL(extractFileDir(appName), blurayHelper, mainMuxer->getPidList(), dt, blankNum, v3Info,
+                           !batchMode, batchPool);
+            }
+        }
+
+        if (!batchMode)
+            LTRACE(LT_INFO, 2, "Mux successful complete");
+    }
+    else
+    {
+        MuxerManager sMuxer(readManager, singleFileMuxerFactory, v3Info, batchPool);
+        sMuxer.setReportProgress(!batchMode);
+        sMuxer.openMetaFile(metaFileName);
+        if (sMuxer.getTrackCnt() == 0)
+            THROW(ERR_COMMON, "No tracks selected")
+
+        // output path - is checked for invalid characters on our platform
+        string dstFile = unquoteStr(outName);
+
+        if (!isValidFileName(dstFile))
+            throw runtime_error(string("Output filename is invalid: ") + dstFile);
+
+        createDir(dstFile, true);
+        sMuxer.doMux(dstFile, nullptr);
+        if (!batchMode)
+            LTRACE(LT_INFO, 2, "Demux complete.");
+    }
+    if (batchMode)
+        return;  // the batch reports the end of the job
+    auto endTime = std::chrono::steady_clock::now();
+    auto totalTime = endTime - startTime;
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(totalTime);
+    auto minutes = std::chrono::duration_cast<std::chrono::minutes>(totalTime);
+    if (muxMode)
+    {
+        LTRACE2(LT_INFO, "Muxing time: ")
+    }
+    else
+        LTRACE2(LT_INFO, "Demuxing time: ")
+    if (minutes.count() > 0)
+    {
+        LTRACE2(LT_INFO, minutes.count() << " min ")
+        seconds -= minutes;
+    }
+    LTRACE(LT_INFO, 2, seconds.count() << " sec");
+}
+
+// Prints the exception being handled, returns the exit code of the program
+int reportError(const bool detectMode)
+{
+    try
+    {
+        throw;
+    }
+    catch (runtime_error& e)
+    {
+        if (detectMode)
+            LTRACE2(LT_ERROR, "Error: ")
+        LTRACE2(LT_ERROR, e.what())
+        return -1;
+    }
+    catch (VodCoreException& e)
+    {
+        if (detectMode)
+            LTRACE2(LT_ERROR, "Error: ")
+        LTRACE(LT_ERROR, 2, e.m_errStr.c_str());
+        return -2;
+    }
+    catch (BitStreamException& e)
+    {
+        if (detectMode)
+            LTRACE2(LT_ERROR, "Error: ")
+        LTRACE(LT_ERROR, 2, "Bitstream exception " << e.what() << EXCEPTION_ERR_MSG);
+        return -3;
+    }
+    catch (...)
+    {
+        if (detectMode)
+            LTRACE2(LT_ERROR, "Error: ")
+        LTRACE(LT_ERROR, 2, "Unknnown exception" << EXCEPTION_ERR_MSG);
+        return -4;
+    }
+}
+
+// Number of threads a job keeps busy: a stream reader per track, a muxer thread per output, two for a stereoscopic
+// output, and the writer. The reader threads of readManager are shared by all jobs and are not counted.
+unsigned getJobThreadCnt(const char* metaFileName)
+{
+    unsigned trackCnt = 0;
+    bool mvcFound = false;
+    TextFile file(metaFileName, File::ofRead);
+    string str;
+    while (file.readLine(str))
+    {
+        str = trimStr(str);
+        if (str.empty() || str[0] == '#' || strStartWith(str, "MUXOPT"))
+            continue;
+        trackCnt++;
+        if (strStartWith(str, "V_MPEG4/ISO/MVC"))
+            mvcFound = true;
+    }
+    return trackCnt + (mvcFound ? 2 : 1) + 1;
+}
+
+struct BatchJob
+{
+    string metaFileName;
+    string outName;
+    unsigned threadCnt;  // see getJobThreadCnt()
+};
+
+// Jobs of a batch, shared by the threads running them. The jobs are started in order, while the threads of the running
+// jobs fit in the thread budget, and take their output blocks from a single pool.
+class BatchJobs
+{
+   public:
+    const char* appName;
+    vector<BatchJob> jobs;
+    unsigned threadBudget = 1;
+    std::unique_ptr<OutputBlockPool> outputBlockPool;
+    std::mutex reportMtx;  // the reports of the jobs are not interleaved
+    size_t failedCnt = 0;
+    int rez = 0;  // exit code of the first failed job
+
+    // Waits until the threads of the next job fit in the budget, a job exceeding the budget runs alone. Returns
+    // false if no job is left.
+    bool startJob(size_t& index)
+    {
+        std::unique_lock lock(m_budgetMtx);
+        m_budgetCond.wait(lock, [this] {
+            return m_nextJob >= jobs.size() || m_usedThreads == 0 ||
+                   m_usedThreads + jobs[m_nextJob].threadCnt <= threadBudget;
+        });
+        if (m_nextJob >= jobs.size())
+            return false;
+        index = m_nextJob++;
+        m_usedThreads += jobs[index].threadCnt;
+        return true;
+    }
+
+    void finishJob(const size_t index)
+    {
+        {
+            std::lock_guard lock(m_budgetMtx);
+            m_usedThreads -= jobs[index].threadCnt;
+        }
+        m_budgetCond.notify_all();
+    }
+
+   private:
+    size_t m_nextJob = 0;
+    unsigned m_usedThreads = 0;
+    std::mutex m_budgetMtx;
+    std::condition_variable m_budgetCond;
+};
+
+// Runs the jobs of a batch one after another, until no job is left
+class BatchThread final : public TerminatableThread
+{
+   public:
+    explicit BatchThread(BatchJobs& batch) : m_batch(batch) { run(this); }
+    ~BatchThread() override { join(); }
+
+   protected:
+    void thread_main() override
+    {
+        size_t i = 0;
+        while (m_batch.startJob(i))
+        {
+            const BatchJob& job = m_batch.jobs[i];
+            const string jobName = "Job " + std::to_string(i + 1) + " of " + std::to_string(m_batch.jobs.size());
+            {
+                std::lock_guard lock(m_batch.reportMtx);
+                LTRACE(LT_INFO, 2, jobName << " started: " << job.metaFileName);
+            }
+            const auto startTime = std::chrono::steady_clock::now();
+            try
+            {
+                muxMetaFile(m_batch.appName, job.metaFileName.c_str(), job.outName.c_str(),
+                            m_batch.outputBlockPool.get());
+                const auto seconds =
+                    std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - startTime);
+                std::lock_guard lock(m_batch.reportMtx);
+                LTRACE(LT_INFO, 2,
+                       jobName << " complete: " << unquoteStr(job.outName) << " (" << seconds.count() << " sec)");
+            }
+            catch (...)
+            {
+                std::lock_guard lock(m_batch.reportMtx);
+                LTRACE2(LT_ERROR, jobName << " failed: ")
+                const int jobRez = reportError(false);
+                if (jobRez == -1)  // runtime errors are reported without a line end
+                    LTRACE(LT_ERROR, 2, "");
+                if (m_batch.rez == 0)
+                    m_batch.rez = jobRez;
+                m_batch.failedCnt++;
+            }
+            m_batch.finishJob(i);
+        }
+    }
+
+   private:
+    BatchJobs& m_batch;
+};
+
+// Number of jobs run at once by default, the thread budget may start fewer of them
+unsigned defaultBatchJobCnt() { return (std::max)(std::thread::hardware_concurrency() / 4, 1u); }
+
+// Runs the jobs of a job list, up to maxJobCnt jobs at once. All jobs share the reader threads of readManager, one
+// per rotational disk, so that the jobs reading the same disk don't compete for it. The reader settings are the ones
+// of the first job, a job list whose jobs have other reader settings is rejected. The threads of the running jobs are
+// limited to the CPU threads, and the jobs share a single pool of output blocks: OUTPUT_BLOCK_POOL_SIZE blocks for
+// the data queued for writing, and a block per thread of the budget for the blocks which the muxers keep. A failed job
+// doesn't stop the batch, the exit code is the one of the first failure.
+int runBatch(const char* appName, const char* jobListName, const unsigned maxJobCnt)
+{
+    BatchJobs batch;
+    batch.appName = appName;
+    {
+        TextFile file(jobListName, File::ofRead);
+        string str;
+        while (file.readLine(str))
+        {
+            str = trimStr(str);
+            if (str.empty() || str[0] == '#')
+                continue;
+            vector<string> params;
+            for (const auto& param : splitQuotedStr(str.c_str(), ' '))
+                if (!param.empty())
+                    params.push_back(param);
+            if (params.size() != 2)
+                throw runtime_error(string("Invalid job in ") + jobListName + ": " + str);
+            batch.jobs.push_back({unquoteStr(params[0]), params[1], 0});
+        }
+    }
+    if (batch.jobs.empty())
+        throw runtime_error(string("No jobs in ") + jobListName);
+
+    // the readers are shared, their settings can't change while the jobs run
+    bool settingsFound = false;
+    ReaderSettings readerSettings;
+    for (auto& job : batch.jobs)
+    {
+        ReaderSettings jobSettings;
+        try
+        {
+            jobSettings = getReaderSettings(job.metaFileName.c_str());
+            job.threadCnt = getJobThreadCnt(job.metaFileName.c_str());
+        }
+        catch (...)
+        {
+            continue;  // the job fails when it is run
+        }
+        if (!settingsFound)
+        {
+            readerSettings = jobSettings;
+            settingsFound = true;
+        }
+        else if (jobSettings != readerSettings)
+            throw runtime_error(string("The reader options of ") + job.metaFileName +
+                                " differ from the ones of the first job, the jobs of a batch must use the same "
+                                "reader options");
+    }
+    setupReadManager(readerSettings);
+
+    batch.threadBudget = (std::max)(std::thread::hardware_concurrency(), 1u);
+    batch.outputBlockPool =
+        std::make_unique<OutputBlockPool>(OUTPUT_BLOCK_SIZE, OUTPUT_BLOCK_POOL_SIZE + batch.threadBudget);
+
+    const auto threadCnt = static_cast<unsigned>((std::min)(static_cast<size_t>(maxJobCnt), batch.jobs.size()));
+    LTRACE(LT_INFO, 2,
+           "Running " << batch.jobs.size() << " jobs, up to " << threadCnt << " at once within "
+                      << batch.threadBudget << " threads");
+    {
+        vector<unique_ptr<BatchThread>> threads;
+        for (unsigned i = 0; i < threadCnt; ++i) threads.push_back(std::make_unique<BatchThread>(batch));
+    }
+    LTRACE(LT_INFO, 2, "");
+    if (batch.failedCnt > 0)
+        LTRACE(LT_ERROR, 2, "Batch complete: " << batch.failedCnt << " of " << batch.jobs.size() << " jobs failed");
+    else
+        LTRACE(LT_INFO, 2, "Batch complete: " << batch.jobs.size() << " jobs");
+    return batch.rez;
+}
+
 #ifdef _WIN32
 #include <shellapi.h>
 #endif
@@ -569,10 +1050,6 @@ int main(int argc, char** argv)
     argv = argv_vec.data();
 #endif
     LTRACE(LT_INFO, 2, "tsMuxeR version " TSMUXER_VERSION << ". github.com/justdan96/tsMuxer");
-    int firstMplsOffset = 0;
-    int firstM2tsOffset = 0;
-    int blankNum = 1900;
-    bool insertBlankPL = false;
     // createBluRayDirs("c:/workshop/");
 
     // MPLSParser parser;
@@ -592,6 +1069,7 @@ int main(int argc, char** argv)
     {
         if (argc == 2)
         {
+            V3Info v3Info;
             string str = argv[1];
             string fileExt = extractFileExt(str);
             fileExt = strToLowerCase(fileExt);
@@ -615,7 +1093,7 @@ int main(int argc, char** argv)
                         {
                             string subItemName = streamDir + mplsParser.m_mvcFiles[0] + mediaExt;
                             if (fileExists(subItemName))
-                                detectStreamReader(subItemName.c_str(), &mplsParser, true);
+                                detectStreamReader(subItemName.c_str(), &mplsParser, true, v3Info);
                             else
                                 switchToSsif = true;
                         }
@@ -630,7 +1108,7 @@ int main(int argc, char** argv)
                         if (fileExists(ssifName))
                             itemName = ssifName;  // if m2ts file absent then swith to ssif
                     }
-                    detectStreamReader(itemName.c_str(), &mplsParser, false);
+                    detectStreamReader(itemName.c_str(), &mplsParser, false, v3Info);
                 }
 
                 size_t markIndex = 0;
@@ -686,7 +1164,7 @@ int main(int argc, char** argv)
                 }
             }
             else
-                detectStreamReader(argv[1], nullptr, false);
+                detectStreamReader(argv[1], nullptr, false, v3Info);
             cout << endl;
             return 0;
         }
@@ -702,157 +1180,20 @@ int main(int argc, char** argv)
             showHelp();
             return -1;
         }
-        string fileExt = extractFileExt(argv[2]);
-        fileExt = strToUpperCase(fileExt);
-        auto startTime = std::chrono::steady_clock::now();
-
-        int autoChapterLen = 0;
-        vector<double> customChapterList;
-        bool stereoMode = false;
-        string isoDiskLabel;
-        DiskType dt = checkBluRayMux(argv[1], autoChapterLen, customChapterList, firstMplsOffset, firstM2tsOffset,
-                                     insertBlankPL, blankNum, stereoMode, isoDiskLabel);
-        std::string fileExt2 = unquoteStr(fileExt);
-        bool muxMode =
-            fileExt2 == "M2TS" || fileExt2 == "TS" || fileExt2 == "SSIF" || fileExt2 == "ISO" || dt != DiskType::NONE;
-
-        if (muxMode)
-        {
-            BlurayHelper blurayHelper;
-
-            MuxerManager muxerManager(readManager, tsMuxerFactory);
-            muxerManager.setAllowStereoMux(fileExt2 == "SSIF" || dt != DiskType::NONE);
-            muxerManager.openMetaFile(argv[1]);
-            if (!isV3() && dt == DiskType::BLURAY && muxerManager.getHevcFound())
-            {
-                LTRACE(LT_INFO, 2, "HEVC stream detected: changing Blu-Ray version to V3.");
-                V3_flags |= HDMV_V3;
-            }
-
-            // output path - is checked for invalid characters on our platform
-            string dstFile = unquoteStr(argv[2]);
-
-            if (!isValidFileName(dstFile))
-                throw runtime_error(string("Output filename is invalid: ") + dstFile);
-
-            if (dt != DiskType::NONE)
-            {
-                if (!blurayHelper.open(dstFile, dt, muxerManager.totalSize(), muxerManager.getExtraISOBlocks(),
-                                       muxerManager.useReproducibleIsoHeader()))
-                    throw runtime_error(string("Can't create output file ") + dstFile);
-                blurayHelper.setVolumeLabel(isoDiskLabel);
-                blurayHelper.createBluRayDirs();
-                dstFile = blurayHelper.m2tsFileName(firstM2tsOffset);
-            }
-            if (muxerManager.getTrackCnt() == 0)
-                THROW(ERR_COMMON, "No tracks selected")
-            muxerManager.doMux(dstFile, dt != DiskType::NONE ? &blurayHelper : nullptr);
-            if (dt != DiskType::NONE)
-            {
-                blurayHelper.writeBluRayFiles(muxerManager, insertBlankPL, firstMplsOffset, blankNum, stereoMode);
-                auto mainMuxer = dynamic_cast<TSMuxer*>(muxerManager.getMainMuxer());
-                auto subMuxer = dynamic_cast<TSMuxer*>(muxerManager.getSubMuxer());
-
-                if (mainMuxer)
-                    blurayHelper.createCLPIFile(mainMuxer, mainMuxer->getFirstFileNum(), true);
-                if (subMuxer)
-                {
-                    blurayHelper.createCLPIFile(subMuxer, subMuxer->getFirstFileNum(), false);
-
-                    IsoWriter* IsoWriter = blurayHelper.isoWriter();
-                    if (IsoWriter)
-                    {
-                        for (size_t i = 0; i < mainMuxer->splitFileCnt(); ++i)
-                        {
-                            string file1 = mainMuxer->getFileNameByIdx(i);
-                            string file2 = subMuxer->getFileNameByIdx(i);
-                            int ssifNum = strToInt32(extractFileName(file1));
-                            if (!file1.empty() && !file2.empty())
-                                IsoWriter->createInterleavedFile(file1, file2, blurayHelper.ssifFileName(ssifNum));
-                        }
-                    }
-                }
-
-                for (auto& i : customChapterList)
-                    i -= static_cast<double>(muxerManager.getCutStart()) / INTERNAL_PTS_FREQ;
-
-                if (subMuxer)
-                    mainMuxer->alignPTS(subMuxer);
-
-                blurayHelper.createMPLSFile(mainMuxer, subMuxer, autoChapterLen, customChapterList, dt, firstMplsOffset,
-                                            muxerManager.isMvcBaseViewR());
-
-                if (insertBlankPL && mainMuxer && !subMuxer)
-                {
-                    LTRACE(LT_INFO, 2, "Adding blank play list");
-                    muxBlankPL(extractFileDir(argv[0]), blurayHelper, mainMuxer->getPidList(), dt, blankNum);
-                }
-            }
-
-            LTRACE(LT_INFO, 2, "Mux successful complete");
-        }
-        else
-        {
-            MuxerManager sMuxer(readManager, singleFileMuxerFactory);
-            sMuxer.openMetaFile(argv[1]);
-            if (sMuxer.getTrackCnt() == 0)
-                THROW(ERR_COMMON, "No tracks selected")
-
-            // output path - is checked for invalid characters on our platform
-            string dstFile = unquoteStr(argv[2]);
-
-            if (!isValidFileName(dstFile))
-                throw runtime_error(string("Output filename is invalid: ") + dstFile);
-
-            createDir(dstFile, true);
-            sMuxer.doMux(dstFile, nullptr);
-            LTRACE(LT_INFO, 2, "Demux complete.");
-        }
-        auto endTime = std::chrono::steady_clock::now();
-        auto totalTime = endTime - startTime;
-        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(totalTime);
-        auto minutes = std::chrono::duration_cast<std::chrono::minutes>(totalTime);
-        if (muxMode)
+        if (strcmp(argv[1], "--batch") == 0)
+            return runBatch(argv[0], argv[2], defaultBatchJobCnt());
+        if (strStartWith(argv[1], "--batch="))
         {
-            LTRACE2(LT_INFO, "Muxing time: ")
+            const unsigned maxJobCnt = strToInt32u(argv[1] + strlen("--batch="));
+            if (maxJobCnt == 0)
+                throw runtime_error(string("Invalid number of jobs: ") + argv[1]);
+            return runBatch(argv[0], argv[2], maxJobCnt);
         }
-        else
-            LTRACE2(LT_INFO, "Demuxing time: ")
-        if (minutes.count() > 0)
-        {
-            LTRACE2(LT_INFO, minutes.count() << " min ")
-            seconds -= minutes;
-        }
-        LTRACE(LT_INFO, 2, seconds.count() << " sec");
-
+        muxMetaFile(argv[0], argv[1], argv[2], nullptr);
         return 0;
     }
-    catch (runtime_error& e)
-    {
-        if (argc == 2)
-            LTRACE2(LT_ERROR, "Error: ")
-        LTRACE2(LT_ERROR, e.what())
-        return -1;
-    }
-    catch (VodCoreException& e)
-    {
-        if (argc == 2)
-            LTRACE2(LT_ERROR, "Error: ")
-        LTRACE(LT_ERROR, 2, e.m_errStr.c_str());
-        return -2;
-    }
-    catch (BitStreamException& e)
-    {
-        if (argc == 2)
-            LTRACE2(LT_ERROR, "Error: ")
-        LTRACE(LT_ERROR, 2, "Bitstream exception " << e.what() << EXCEPTION_ERR_MSG);
-        return -3;
-    }
     catch (...)
     {
-        if (argc == 2)
-            LTRACE2(LT_ERROR, "Error: ")
-        LTRACE(LT_ERROR, 2, "Unknnown exception" << EXCEPTION_ERR_MSG);
-        return -4;
+        return reportError(argc == 2);
     }
 }
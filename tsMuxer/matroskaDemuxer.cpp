@@ -187,8 +187,8 @@ int MatroskaDemuxer::matroska_parse_index()
     return res;
 }
 
-MatroskaDemuxer::MatroskaDemuxer(const BufferedReaderManager &readManager)
-    : IOContextDemuxer(readManager), levels(), m_title(), created(0), fileDuration(0)
+MatroskaDemuxer::MatroskaDemuxer(BufferedReaderManager &readManager, const char *streamName)
+    : IOContextDemuxer(readManager, streamName), levels(), m_title(), created(0), fileDuration(0)
 {
     m_lastDeliveryPacket = nullptr;
     num_levels = 0;
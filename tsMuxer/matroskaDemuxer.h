@@ -1,13 +1,15 @@
 #ifndef MATROSKA_STREAM_READER_H_
 #define MATROSKA_STREAM_READER_H_
 
+#include <queue>
+
 #include "ioContextDemuxer.h"
 #include "matroskaParser.h"
 
 class MatroskaDemuxer final : public IOContextDemuxer
 {
    public:
-    MatroskaDemuxer(const BufferedReaderManager &readManager);
+    MatroskaDemuxer(BufferedReaderManager &readManager, const char *streamName = "");
     ~MatroskaDemuxer() override { readClose(); }
     void openFile(const std::string &streamName) override;
     int readPacket(AVPacket &avPacket);  // not implemented
@@ -5,6 +5,7 @@
 
 #include <fs/textfile.h>
 #include <types/types.h>
+#include <algorithm>
 #include <climits>
 
 #include "aacStreamReader.h"
@@ -36,15 +37,21 @@ using namespace std;
 
 static constexpr int MAX_DEMUX_BUFFER_SIZE = 1024 * 1024 * 192;
 static constexpr int MIN_READED_BLOCK = 16384;
+static constexpr int64_t NO_TIME_STAMP = LLONG_MIN;
 
-METADemuxer::METADemuxer(const BufferedReaderManager& readManager)
-    : m_containerReader(*this, readManager), m_readManager(readManager)
+METADemuxer::METADemuxer(BufferedReaderManager& readManager, V3Info& v3Info)
+    : m_containerReader(*this, readManager), m_readManager(readManager), m_v3Info(v3Info)
 {
+    m_reportProgress = true;
     m_flushDataMode = false;
     m_HevcFound = false;
     m_totalSize = 0;
     m_lastProgressY = 0;
     m_lastReadRez = 0;
+    m_parallelRead = true;
+    m_packetConsumer = nullptr;
+    m_packetCount = 0;
+    m_consumedPackets = 0;
 }
 
 METADemuxer::~METADemuxer()
@@ -56,64 +63,161 @@ METADemuxer::~METADemuxer()
 int64_t METADemuxer::getDemuxedSize()
 {
     int64_t rez = 0;
-    for (const StreamInfo& si : m_codecInfo)
-        rez += si.m_streamReader->getProcessedSize();  // m_codecInfo[i].m_dataProcessed;
+    for (size_t i = 0; i < m_codecInfo.size(); i++)
+    {
+        const StreamInfo& si = m_codecInfo[i];
+        // the reader of a stream parsed by a thread is only accessed while the thread is waiting
+        if (i < m_readerThreads.size() && m_readerThreads[i] && !si.m_flushed)
+            rez += m_readerThreads[i]->getProcessedSize();
+        else
+            rez += si.m_streamReader->getProcessedSize();  // m_codecInfo[i].m_dataProcessed;
+    }
     return rez + m_containerReader.getDiscardedSize();
 }
 
+void METADemuxer::startReaderThreads()
+{
+    m_readerThreads.resize(m_codecInfo.size());
+    if (!m_parallelRead || m_codecInfo.size() < 2)
+        return;
+    for (size_t i = 0; i < m_codecInfo.size(); i++)
+    {
+        StreamInfo& si = m_codecInfo[i];
+        // the tracks of a container share its demuxer
+        if (dynamic_cast<BufferedReader*>(si.m_dataReader) == nullptr)
+            continue;
+        // the text renderer is shared by all text subtitle streams
+        if (dynamic_cast<SRTStreamReader*>(si.m_streamReader))
+            continue;
+        m_readerThreads[i] = std::make_unique<StreamReaderThread>(si);
+    }
+}
+
+void METADemuxer::stopReaderThreads()
+{
+    m_readerThreads.clear();
+    m_stepStreams.clear();
+}
+
+void METADemuxer::setPacketConsumer(PacketConsumer* consumer)
+{
+    // the packets returned before are consumed already
+    m_packetConsumer = consumer;
+    m_packetCount = 0;
+    m_consumedPackets = 0;
+    std::fill(m_streamPackets.begin(), m_streamPackets.end(), 0);
+}
+
+bool METADemuxer::isConsumed(const int streamIndex)
+{
+    if (m_packetConsumer == nullptr || m_streamPackets[streamIndex] <= m_consumedPackets)
+        return true;
+    m_consumedPackets = m_packetConsumer->consumedPackets();
+    return m_streamPackets[streamIndex] <= m_consumedPackets;
+}
+
+void METADemuxer::waitConsumed(const int streamIndex)
+{
+    // the data of the last packet of the stream is overwritten when the stream is parsed again
+    if (!isConsumed(streamIndex))
+        m_consumedPackets = m_packetConsumer->waitConsumed(m_streamPackets[streamIndex]);
+}
+
+void METADemuxer::initStreamQueue()
+{
+    m_streamQueue = {};
+    m_readStreams.clear();
+    for (int i = 0; i < static_cast<int>(m_codecInfo.size()); i++)
+    {
+        m_streamQueue.emplace(m_codecInfo[i].m_lastDTS, i);
+        if (!m_readerThreads[i] && m_codecInfo[i].needRead())
+            m_readStreams.push_back(i);
+    }
+}
+
+int METADemuxer::readStreams(std::vector<int>& delayedStreams)
+{
+    int rez = 0;
+    for (const int i : m_readStreams)
+    {
+        StreamInfo& streamInfo = m_codecInfo[i];
+        if (streamInfo.m_lastAVRez != 0)
+            waitConsumed(i);
+        streamInfo.lastReadRez = streamInfo.read();
+        if (streamInfo.lastReadRez == BufferedFileReader::DATA_DELAYED)
+            delayedStreams.push_back(i);
+        else if (streamInfo.lastReadRez == BufferedFileReader::DATA_NOT_READY)
+        {
+            rez = BufferedFileReader::DATA_NOT_READY;
+            break;
+        }
+    }
+    m_readStreams.erase(std::remove_if(m_readStreams.begin(), m_readStreams.end(),
+                                       [this](const int i) { return !m_codecInfo[i].needRead(); }),
+                        m_readStreams.end());
+    return rez;
+}
+
+int METADemuxer::nextStream(const std::vector<int>& delayedStreams)
+{
+    int index = -1;
+    std::vector<StreamOrder> skipped;
+    while (!m_streamQueue.empty())
+    {
+        const StreamOrder next = m_streamQueue.top();
+        m_streamQueue.pop();
+        if (std::find(delayedStreams.begin(), delayedStreams.end(), next.second) == delayedStreams.end())
+        {
+            index = next.second;
+            break;
+        }
+        skipped.push_back(next);
+    }
+    for (const StreamOrder& order : skipped) m_streamQueue.push(order);
+    return index;
+}
+
 int METADemuxer::readPacket(AVPacket& avPacket)
 
 {
+    if (m_readerThreads.size() != m_codecInfo.size())
+    {
+        startReaderThreads();
+        initStreamQueue();
+        m_streamPackets.assign(m_codecInfo.size(), 0);
+    }
+    // the readers of the streams whose packets are consumed may go on
+    for (auto itr = m_stepStreams.begin(); itr != m_stepStreams.end();)
+    {
+        if (isConsumed(*itr))
+        {
+            m_readerThreads[*itr]->nextStep();
+            itr = m_stepStreams.erase(itr);
+        }
+        else
+            ++itr;
+    }
+
     avPacket.stream_index = 0;
     avPacket.data = nullptr;
     avPacket.size = 0;
     avPacket.codec = nullptr;
     m_lastReadRez = 0;
+    std::vector<int> delayedStreams;
     while (true)
     {
-        int minDtsIndex = -1;
-        int64_t minDts = LLONG_MAX;
-        bool allDataDelayed = true;
+        // Only the streams which need data or a notification are read. The stream with the lowest DTS is taken from
+        // the queue, streams with delayed data are skipped.
+        bool allDataDelayed = !m_flushDataMode;
         while (allDataDelayed)
         {
-            for (int i = 0; i < static_cast<int>(m_codecInfo.size()); i++)
+            delayedStreams.clear();
+            if (readStreams(delayedStreams) == BufferedFileReader::DATA_NOT_READY)
             {
-                StreamInfo& streamInfo = m_codecInfo[i];
-                if (!m_flushDataMode)
-                {
-                    streamInfo.lastReadRez = streamInfo.read();
-                    if (streamInfo.lastReadRez == BufferedFileReader::DATA_DELAYED)
-                        continue;  // skip stream
-                    allDataDelayed = false;
-                    if (streamInfo.lastReadRez == BufferedFileReader::DATA_NOT_READY)
-                    {
-                        m_lastReadRez = BufferedFileReader::DATA_NOT_READY;
-                        return BufferedFileReader::DATA_NOT_READY;
-                    }
-                    if (streamInfo.lastReadRez != BufferedFileReader::DATA_EOF2)
-                    {
-                        if (streamInfo.m_lastDTS < minDts)
-                        {
-                            minDtsIndex = i;
-                            minDts = streamInfo.m_lastDTS;
-                        }
-                    }
-                    else if (streamInfo.m_lastDTS < minDts && !streamInfo.m_flushed)
-                    {
-                        minDtsIndex = i;
-                        minDts = streamInfo.m_lastDTS;
-                    }
-                }
-                else
-                {
-                    allDataDelayed = false;
-                    if (streamInfo.m_lastDTS < minDts && !streamInfo.m_flushed)
-                    {
-                        minDtsIndex = i;
-                        minDts = streamInfo.m_lastDTS;
-                    }
-                }
+                m_lastReadRez = BufferedFileReader::DATA_NOT_READY;
+                return BufferedFileReader::DATA_NOT_READY;
             }
+            allDataDelayed = delayedStreams.size() == m_codecInfo.size();
             if (allDataDelayed)
                 for (const StreamInfo& si : m_codecInfo)
                 {
@@ -122,37 +226,74 @@ int METADemuxer::readPacket(AVPacket& avPacket)
                         cReader->resetDelayedMark();
                 }
         }
+        const int minDtsIndex = nextStream(delayedStreams);
         if (minDtsIndex != -1)
         {
+            StreamInfo& streamInfo = m_codecInfo[minDtsIndex];
             if (!m_flushDataMode)
             {
-                if (m_codecInfo[minDtsIndex].lastReadRez != BufferedFileReader::DATA_EOF2)
+                StreamReaderThread* readerThread = m_readerThreads[minDtsIndex].get();
+                if (readerThread)
+                {
+                    const auto itr = std::find(m_stepStreams.begin(), m_stepStreams.end(), minDtsIndex);
+                    if (itr != m_stepStreams.end())
+                    {
+                        waitConsumed(minDtsIndex);
+                        readerThread->nextStep();
+                        m_stepStreams.erase(itr);
+                    }
+                    readerThread->waitStep();
+                }
+                if (streamInfo.lastReadRez != BufferedFileReader::DATA_EOF2)
                 {
-                    const int res = m_codecInfo[minDtsIndex].m_streamReader->readPacket(avPacket);
-                    m_codecInfo[minDtsIndex].m_lastAVRez = res;
+                    if (readerThread)
+                    {
+                        readerThread->takePacket(avPacket);
+                        m_stepStreams.push_back(minDtsIndex);
+                    }
+                    else
+                    {
+                        waitConsumed(minDtsIndex);
+                        const int res = streamInfo.m_streamReader->readPacket(avPacket);
+                        streamInfo.m_lastAVRez = res;
+                    }
                 }
                 else
                 {
                     // flush single stream
-                    m_codecInfo[minDtsIndex].m_streamReader->flushPacket(avPacket);
-                    m_codecInfo[minDtsIndex].m_flushed = true;
+                    waitConsumed(minDtsIndex);
+                    streamInfo.m_streamReader->flushPacket(avPacket);
+                    streamInfo.m_flushed = true;
                 }
                 // add time shift from external sync source
                 // add static time shift
-                avPacket.dts += m_codecInfo[minDtsIndex].m_timeShift;
-                avPacket.pts += m_codecInfo[minDtsIndex].m_timeShift;
-                m_codecInfo[minDtsIndex].m_lastDTS = avPacket.dts + avPacket.duration;
+                avPacket.dts += streamInfo.m_timeShift;
+                avPacket.pts += streamInfo.m_timeShift;
+                streamInfo.m_lastDTS = avPacket.dts + avPacket.duration;
             }
             else
             {  // flush all streams
-                m_codecInfo[minDtsIndex].m_streamReader->flushPacket(avPacket);
-                m_codecInfo[minDtsIndex].m_flushed = true;
+                waitConsumed(minDtsIndex);
+                streamInfo.m_streamReader->flushPacket(avPacket);
+                streamInfo.m_flushed = true;
+            }
+            if (!streamInfo.m_flushed)
+                m_streamQueue.emplace(streamInfo.m_lastDTS, minDtsIndex);
+            if (!m_readerThreads[minDtsIndex] && streamInfo.needRead())
+            {
+                const auto itr = std::lower_bound(m_readStreams.begin(), m_readStreams.end(), minDtsIndex);
+                if (itr == m_readStreams.end() || *itr != minDtsIndex)
+                    m_readStreams.insert(itr, minDtsIndex);
             }
+            m_streamPackets[minDtsIndex] = ++m_packetCount;
             updateReport(true);
             return 0;
         }
         if (!m_flushDataMode)
+        {
             m_flushDataMode = true;
+            delayedStreams.clear();
+        }
         else
         {
             updateReport(false);
@@ -398,6 +539,7 @@ int METADemuxer::addStream(const string& codec, const string& codecStreamName, c
     }
 
     AbstractStreamReader* codecReader = createCodec(codec, addParams, fileList[0], mergePlayItems(mplsInfoList));
+    codecReader->setV3Info(&m_v3Info);
     codecReader->setStreamIndex(static_cast<int>(m_codecInfo.size() + 1));
     codecReader->setTimeOffset(m_timeOffset);
 
@@ -483,7 +625,7 @@ int METADemuxer::addStream(const string& codec, const string& codecStreamName, c
     m_codecInfo.emplace_back(dataReader, codecReader, fileList[0], codecStreamName, pid, isSubStream);
     if (listIterator)
     {
-        auto fileReader = dynamic_cast<BufferedFileReader*>(dataReader);
+        auto fileReader = dynamic_cast<BufferedReader*>(dataReader);
         if (fileReader)
             fileReader->setFileIterator(listIterator, m_codecInfo.rbegin()->m_readerID);
     }
@@ -547,6 +689,9 @@ int METADemuxer::addStream(const string& codec, const string& codecStreamName, c
 
 void METADemuxer::readClose()
 {
+    stopReaderThreads();
+    m_streamQueue = {};
+    m_readStreams.clear();
     for (const auto& codecInfo : m_codecInfo)
     {
         codecInfo.m_dataReader->deleteReader(codecInfo.m_readerID);
@@ -555,8 +700,8 @@ void METADemuxer::readClose()
     m_codecInfo.clear();
 }
 
-DetectStreamRez METADemuxer::DetectStreamReader(const BufferedReaderManager& readManager, const string& fileName,
-                                                bool calcDuration)
+DetectStreamRez METADemuxer::DetectStreamReader(BufferedReaderManager& readManager, const string& fileName,
+                                                bool calcDuration, V3Info& v3Info)
 {
     AVChapters chapters;
     int64_t fileDuration = 0;
@@ -625,7 +770,7 @@ DetectStreamRez METADemuxer::DetectStreamReader(const BufferedReaderManager& rea
         {
             StreamData& vect = itr.second;
             CheckStreamRez trackRez = detectTrackReader(vect.data(), static_cast<int>(vect.size()), containerType,
-                                                        acceptedPidMap[itr.first].m_trackType, itr.first);
+                                                        acceptedPidMap[itr.first].m_trackType, itr.first, v3Info);
             if (!trackRez.codecInfo.programName.empty())
             {
                 if (trackRez.codecInfo.programName[0] != 'S')
@@ -682,7 +827,7 @@ DetectStreamRez METADemuxer::DetectStreamReader(const BufferedReaderManager& rea
             containerType = AbstractStreamReader::ContainerType::ctLPCM;
         else if (fileExt == "srt")
             containerType = AbstractStreamReader::ContainerType::ctSRT;
-        CheckStreamRez trackRez = detectTrackReader(tmpBuffer, len, containerType, 0, 0);
+        CheckStreamRez trackRez = detectTrackReader(tmpBuffer, len, containerType, 0, 0, v3Info);
 
         if (strStartWith(trackRez.codecInfo.programName, "V_"))
             addTrack(Vstreams, trackRez);
@@ -720,11 +865,12 @@ void METADemuxer::addTrack(vector<CheckStreamRez>& rez, CheckStreamRez trackRez)
 
 CheckStreamRez METADemuxer::detectTrackReader(uint8_t* tmpBuffer, int len,
                                               AbstractStreamReader::ContainerType containerType, int containerDataType,
-                                              int containerStreamIndex)
+                                              int containerStreamIndex, V3Info& v3Info)
 {
     CheckStreamRez rez;
 
     auto pgsReader = new PGSStreamReader();
+    pgsReader->setV3Info(&v3Info);
     rez = pgsReader->checkStream(tmpBuffer, len, containerType, containerDataType, containerStreamIndex);
     delete pgsReader;
     if (rez.codecInfo.codecID)
@@ -782,6 +928,7 @@ CheckStreamRez METADemuxer::detectTrackReader(uint8_t* tmpBuffer, int len,
         return rez;
 
     auto hevcCodec = new HEVCStreamReader();
+    hevcCodec->setV3Info(&v3Info);
     rez = hevcCodec->checkStream(tmpBuffer, len);
     delete hevcCodec;
     if (rez.codecInfo.codecID)
@@ -1186,6 +1333,8 @@ string METADemuxer::findBluRayFile(const string& streamDir, const string& reques
 
 void METADemuxer::updateReport(const bool checkTime)
 {
+    if (!m_reportProgress)
+        return;
     const auto currentTime = std::chrono::steady_clock::now();
     if (!checkTime || currentTime - m_lastReportTime > std::chrono::microseconds(250000))
     {
@@ -1226,6 +1375,12 @@ void METADemuxer::lineBack()
 }
 
 // ------------------- StreamInfo ---------------------
+bool StreamInfo::needRead() const
+{
+    // read() doesn't do anything else for the streams which have data and have notified their reader
+    return !m_flushed && (m_lastAVRez != 0 || (m_asyncMode && !m_notificated && !m_isEOF));
+}
+
 int StreamInfo::read()
 {
     // m_readRez = 0;
@@ -1260,6 +1415,99 @@ int StreamInfo::read()
     return readRez;
 }
 
+// ------------------------------ StreamReaderThread --------------------------------
+
+StreamReaderThread::StreamReaderThread(StreamInfo& streamInfo)
+    : m_streamInfo(streamInfo), m_stepRequested(true), m_stepDone(false), m_terminated(false), m_processedSize(0)
+{
+    run(this);
+}
+
+StreamReaderThread::~StreamReaderThread()
+{
+    {
+        std::lock_guard lk(m_mtx);
+        m_terminated = true;
+    }
+    m_cond.notify_all();
+    join();
+}
+
+void StreamReaderThread::nextStep()
+{
+    {
+        std::lock_guard lk(m_mtx);
+        m_stepDone = false;
+        m_stepRequested = true;
+    }
+    m_cond.notify_all();
+}
+
+void StreamReaderThread::waitStep()
+{
+    std::unique_lock lk(m_mtx);
+    m_cond.wait(lk, [this] { return m_stepDone; });
+    if (m_error)
+        std::rethrow_exception(m_error);
+    m_processedSize = m_streamInfo.m_streamReader->getProcessedSize();
+}
+
+void StreamReaderThread::takePacket(AVPacket& avPacket) const
+{
+    const int64_t pts = avPacket.pts;
+    const int64_t dts = avPacket.dts;
+    const int64_t pos = avPacket.pos;
+    const int64_t pcr = avPacket.pcr;
+    avPacket = m_packet;
+    // the reader may leave fields of the packet untouched, as when it reads into the packet of the caller
+    avPacket.pts = m_packet.pts == NO_TIME_STAMP ? pts : m_packet.pts;
+    avPacket.dts = m_packet.dts == NO_TIME_STAMP ? dts : m_packet.dts;
+    avPacket.pos = pos;
+    avPacket.pcr = pcr;
+}
+
+void StreamReaderThread::step()
+{
+    m_streamInfo.lastReadRez = m_streamInfo.read();
+    if (m_streamInfo.lastReadRez == BufferedFileReader::DATA_EOF2)
+        return;  // flushed by the demuxer
+    m_packet.pts = m_packet.dts = NO_TIME_STAMP;
+    m_packet.data = nullptr;
+    m_packet.size = 0;
+    m_packet.codec = nullptr;
+    m_packet.stream_index = 0;
+    m_streamInfo.m_lastAVRez = m_streamInfo.m_streamReader->readPacket(m_packet);
+}
+
+void StreamReaderThread::thread_main()
+{
+    while (true)
+    {
+        {
+            std::unique_lock lk(m_mtx);
+            m_cond.wait(lk, [this] { return m_stepRequested || m_terminated; });
+            if (m_terminated)
+                return;
+            m_stepRequested = false;
+        }
+        std::exception_ptr error;
+        try
+        {
+            step();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard lk(m_mtx);
+            m_error = error;
+            m_stepDone = true;
+        }
+        m_cond.notify_all();
+    }
+}
+
 // ------------------------------ ContainerToReaderWrapper --------------------------------
 
 uint8_t* ContainerToReaderWrapper::readBlock(const int readerID, uint32_t& readCnt, int& rez, bool* firstBlockVar)
@@ -1270,8 +1518,8 @@ uint8_t* ContainerToReaderWrapper::readBlock(const int readerID, uint32_t& readC
     if (itr == m_readerInfo.end())
         return nullptr;
 
-    DemuxerData& demuxerData = itr->second.m_demuxerData;
-    const int pid = itr->second.m_pid;
+    ReaderInfo& readerInfo = itr->second;
+    DemuxerData& demuxerData = readerInfo.m_demuxerData;
     const uint32_t nFileBlockSize = demuxerData.m_demuxer->getFileBlockSize();
 
     if (demuxerData.m_firstRead)
@@ -1284,34 +1532,30 @@ uint8_t* ContainerToReaderWrapper::readBlock(const int readerID, uint32_t& readC
         }
         demuxerData.m_firstRead = false;
     }
-    StreamData& streamData = demuxerData.demuxedData[pid];
+    if (readerInfo.m_streamData == nullptr)
+        readerInfo.m_streamData = &demuxerData.demuxedData[readerInfo.m_pid];
+    StreamData& streamData = *readerInfo.m_streamData;
 
-    const uint32_t lastReadCnt = demuxerData.lastReadCnt[pid];
+    const uint32_t lastReadCnt = readerInfo.m_lastReadCnt;
     if (lastReadCnt > 0)
     {
-        demuxerData.lastReadCnt[pid] = 0;
-        const size_t currentSize = streamData.size() - m_readBuffOffset;
-        assert(currentSize >= lastReadCnt);
-        if (currentSize > lastReadCnt)
-        {
-            uint8_t* dataStart = streamData.data() + m_readBuffOffset;
-            memmove(dataStart, dataStart + lastReadCnt, static_cast<size_t>(currentSize) - lastReadCnt);
-        }
-        streamData.resize(static_cast<int>(m_readBuffOffset + currentSize - lastReadCnt));
-        demuxerData.lastReadCnt[pid] = 0;
+        readerInfo.m_lastReadCnt = 0;
+        assert(streamData.size() - m_readBuffOffset >= lastReadCnt);
+        // the m_readBuffOffset bytes in front of the data are a scratch area for the stream reader: dropping the data
+        // from the start of the block keeps it in front of the remaining data
+        streamData.skip(lastReadCnt);
     }
 
     readCnt = static_cast<uint32_t>((FFMIN(streamData.size(), nFileBlockSize) - m_readBuffOffset));
-    const DemuxerReadPolicy policy = demuxerData.m_pids[pid];
-    if ((readCnt > 0 && (policy == DemuxerReadPolicy::drpFragmented || demuxerData.lastReadCnt[pid] == DATA_EOF2 ||
-                         demuxerData.lastReadCnt[pid] == DATA_EOF2)) ||
+    const DemuxerReadPolicy policy = readerInfo.m_policy;
+    if ((readCnt > 0 && (policy == DemuxerReadPolicy::drpFragmented || readerInfo.m_lastReadCnt == DATA_EOF2)) ||
         readCnt >= MIN_READED_BLOCK)
     {
         data = streamData.data();
-        demuxerData.lastReadCnt[pid] = readCnt;
-        demuxerData.lastReadRez[pid] = 0;
+        readerInfo.m_lastReadCnt = readCnt;
+        readerInfo.m_lastReadRez = 0;
     }
-    else if (demuxerData.lastReadRez[pid] != DATA_DELAYED || demuxerData.m_allFragmented)
+    else if (readerInfo.m_lastReadRez != DATA_DELAYED || demuxerData.m_allFragmented)
     {
         int demuxRez;
         do
@@ -1337,7 +1581,7 @@ uint8_t* ContainerToReaderWrapper::readBlock(const int readerID, uint32_t& readC
         } while (demuxRez == 0 && readCnt < MIN_READED_BLOCK && policy != DemuxerReadPolicy::drpFragmented &&
                  !m_terminated);
 
-        demuxerData.lastReadCnt[pid] = readCnt;
+        readerInfo.m_lastReadCnt = readCnt;
         data = streamData.data();
         if (readCnt > 0)
         {
@@ -1352,7 +1596,7 @@ uint8_t* ContainerToReaderWrapper::readBlock(const int readerID, uint32_t& readC
             else
                 rez = DATA_DELAYED;
         }
-        demuxerData.lastReadRez[pid] = rez;
+        readerInfo.m_lastReadRez = rez;
     }
     else
         rez = DATA_DELAYED;
@@ -1365,16 +1609,12 @@ void ContainerToReaderWrapper::terminate()
     for (const auto& demuxer : m_demuxers) demuxer.second.m_demuxer->terminate();
 }
 
-void ContainerToReaderWrapper::resetDelayedMark() const
+void ContainerToReaderWrapper::resetDelayedMark()
 {
     for (auto& itr : m_readerInfo)
     {
-        DemuxerData& demuxerData = itr.second.m_demuxerData;
-        for (auto& itr2 : demuxerData.lastReadRez)
-        {
-            if (itr2.second == DATA_DELAYED)
-                itr2.second = 0;
-        }
+        if (itr.second.m_lastReadRez == DATA_DELAYED)
+            itr.second.m_lastReadRez = 0;
     }
 }
 
@@ -1407,27 +1647,27 @@ bool ContainerToReaderWrapper::openStream(int readerID, const char* streamName,
         string ext = strToUpperCase(extractFileExt(streamName));
         if ((ext == "264" || ext == "H264" || ext == "MVC") && pid)
         {
-            demuxer = m_demuxers[streamName].m_demuxer = new CombinedH264Demuxer(m_readManager, "");
+            demuxer = m_demuxers[streamName].m_demuxer = new CombinedH264Demuxer(m_readManager, streamName);
             m_demuxers[streamName].m_streamName = streamName;
         }
         else if (ext == "TS" || ext == "M2TS" || ext == "MTS" || ext == "M2T" || ext == "SSIF")
         {
-            demuxer = m_demuxers[streamName].m_demuxer = new TSDemuxer(m_readManager, "");
+            demuxer = m_demuxers[streamName].m_demuxer = new TSDemuxer(m_readManager, streamName);
             m_demuxers[streamName].m_streamName = streamName;
         }
         else if (ext == "EVO" || ext == "VOB" || ext == "MPG" || ext == "MPEG")
         {
-            demuxer = m_demuxers[streamName].m_demuxer = new ProgramStreamDemuxer(m_readManager);
+            demuxer = m_demuxers[streamName].m_demuxer = new ProgramStreamDemuxer(m_readManager, streamName);
             m_demuxers[streamName].m_streamName = streamName;
         }
         else if (ext == "MKV" || ext == "MKA" || ext == "MKS")
         {
-            demuxer = m_demuxers[streamName].m_demuxer = new MatroskaDemuxer(m_readManager);
+            demuxer = m_demuxers[streamName].m_demuxer = new MatroskaDemuxer(m_readManager, streamName);
             m_demuxers[streamName].m_streamName = streamName;
         }
         else if (ext == "MOV" || ext == "MP4" || ext == "M4V" || ext == "M4A")
         {
-            demuxer = m_demuxers[streamName].m_demuxer = new MovDemuxer(m_readManager);
+            demuxer = m_demuxers[streamName].m_demuxer = new MovDemuxer(m_readManager, streamName);
             m_demuxers[streamName].m_streamName = streamName;
         }
         else
@@ -1459,16 +1699,15 @@ bool ContainerToReaderWrapper::openStream(int readerID, const char* streamName,
             tsDemuxer->setMPLSInfo(itr->second.m_playItems);
     }
 
+    DemuxerReadPolicy policy = DemuxerReadPolicy::drpReadSequence;
     if (codecInfo &&
         (codecInfo->codecID == CODEC_S_PGS || codecInfo->codecID == CODEC_S_SUP || codecInfo->codecID == CODEC_S_SRT))
-        m_demuxers[streamName].m_pids[pid] = DemuxerReadPolicy::drpFragmented;
+        policy = DemuxerReadPolicy::drpFragmented;
     else
-    {
-        m_demuxers[streamName].m_pids[pid] = DemuxerReadPolicy::drpReadSequence;
         m_demuxers[streamName].m_allFragmented = false;
-    }
+    m_demuxers[streamName].m_pids[pid] = policy;
     m_demuxers[streamName].m_pidSet.insert(pid);
-    m_readerInfo.insert(std::make_pair(readerID, ReaderInfo(m_demuxers[streamName], pid)));
+    m_readerInfo.insert(std::make_pair(readerID, ReaderInfo(m_demuxers[streamName], pid, policy)));
     return true;
 }
 
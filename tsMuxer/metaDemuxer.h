@@ -1,8 +1,16 @@
 #ifndef META_DEMUXER_H_
 #define META_DEMUXER_H_
 
+#include <system/terminatablethread.h>
+
 #include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <set>
 #include <string>
 #include <vector>
@@ -45,6 +53,8 @@ struct StreamInfo
     }
 
     int read();
+    //! Returns false if read() would only return 0
+    [[nodiscard]] bool needRead() const;
 
     int m_lastAVRez;
     int64_t m_readCnt;
@@ -67,6 +77,52 @@ struct StreamInfo
     bool m_isSubStream;
 };
 
+// Parses the packets of a stream on a thread of its own, a single packet ahead of the muxer: the muxer calls back the
+// stream reader while it muxes a packet (writeAdditionData(), writePESExtension()), so the next packet is parsed only
+// once the previous one has been muxed. The data of a packet stays valid until the next step is started.
+class StreamReaderThread final : public TerminatableThread
+{
+   public:
+    explicit StreamReaderThread(StreamInfo& streamInfo);
+    ~StreamReaderThread() override;
+
+    //! Starts parsing the next packet
+    void nextStep();
+    //! Waits for the end of the current step. lastReadRez of the stream is DATA_EOF2 if the stream must be flushed
+    void waitStep();
+    //! Returns the packet parsed by the step. The time stamps of avPacket are kept if the reader didn't set them
+    void takePacket(AVPacket& avPacket) const;
+    [[nodiscard]] int64_t getProcessedSize() const { return m_processedSize; }
+
+   protected:
+    void thread_main() override;
+
+   private:
+    void step();
+
+    StreamInfo& m_streamInfo;
+    std::mutex m_mtx;
+    std::condition_variable m_cond;
+    bool m_stepRequested;
+    bool m_stepDone;
+    bool m_terminated;
+    AVPacket m_packet;
+    int64_t m_processedSize;  // processed size of the stream reader, as of the last waitStep()
+    std::exception_ptr m_error;
+};
+
+// Receives the packets returned by METADemuxer::readPacket() and processes them later, on another thread. The data of
+// a packet belongs to its stream reader: the demuxer doesn't parse the stream again until the packet is consumed.
+class PacketConsumer
+{
+   public:
+    virtual ~PacketConsumer() = default;
+    //! Returns the number of packets processed so far
+    [[nodiscard]] virtual int64_t consumedPackets() const = 0;
+    //! Waits until at least packetCount packets are processed, returns the number of processed packets
+    virtual int64_t waitConsumed(int64_t packetCount) = 0;
+};
+
 enum class DemuxerReadPolicy
 {
     drpReadSequence,
@@ -86,8 +142,6 @@ class ContainerToReaderWrapper final : public AbstractReader
         std::string m_streamName;
         DemuxedData demuxedData;
         FileNameIterator* m_iterator;
-        std::map<uint32_t, uint32_t> lastReadCnt;
-        std::map<uint32_t, uint32_t> lastReadRez;
         DemuxerData()
         {
             m_demuxer = nullptr;
@@ -101,13 +155,21 @@ class ContainerToReaderWrapper final : public AbstractReader
 
     struct ReaderInfo
     {
-        ReaderInfo(DemuxerData& demuxerData, const int pid) : m_demuxerData(demuxerData), m_pid(pid) {}
+        ReaderInfo(DemuxerData& demuxerData, const int pid, const DemuxerReadPolicy policy)
+            : m_demuxerData(demuxerData), m_pid(pid), m_policy(policy), m_streamData(nullptr), m_lastReadCnt(0),
+              m_lastReadRez(0)
+        {
+        }
 
         DemuxerData& m_demuxerData;
         int m_pid;
+        DemuxerReadPolicy m_policy;
+        StreamData* m_streamData;  // demuxed data of the track, in m_demuxerData
+        uint32_t m_lastReadCnt;    // size of the data returned by the previous call, dropped on the next one
+        int m_lastReadRez;
     };
 
-    ContainerToReaderWrapper(const METADemuxer& owner, const BufferedReaderManager& readManager)
+    ContainerToReaderWrapper(const METADemuxer& owner, BufferedReaderManager& readManager)
         : m_readBuffOffset(0), m_readManager(readManager), m_owner(owner)
     {
         const auto& brm = const_cast<BufferedReaderManager&>(readManager);
@@ -128,7 +190,7 @@ class ContainerToReaderWrapper final : public AbstractReader
     void deleteReader(int readerID) override;
     bool openStream(int readerID, const char* streamName, int pid = 0, const CodecInfo* codecInfo = nullptr) override;
     void setFileIterator(const char* streamName, FileNameIterator* itr);
-    void resetDelayedMark() const;
+    void resetDelayedMark();
     [[nodiscard]] int64_t getDiscardedSize() const { return m_discardedSize; }
 
     bool gotoByte(int readerID, int64_t seekDist) override { return false; }
@@ -139,7 +201,7 @@ class ContainerToReaderWrapper final : public AbstractReader
     int64_t m_discardedSize;
     int32_t m_readerCnt;
     size_t m_readBuffOffset;
-    const BufferedReaderManager& m_readManager;
+    BufferedReaderManager& m_readManager;
     std::map<uint32_t, ReaderInfo> m_readerInfo;
     const METADemuxer& m_owner;
     bool m_terminated;
@@ -159,7 +221,7 @@ struct DetectStreamRez
 class METADemuxer final : public AbstractDemuxer
 {
    public:
-    METADemuxer(const BufferedReaderManager& readManager);
+    METADemuxer(BufferedReaderManager& readManager, V3Info& v3Info);
     ~METADemuxer() override;
     int readPacket(AVPacket& avPacket);
     void readClose() override;
@@ -168,10 +230,15 @@ class METADemuxer final : public AbstractDemuxer
                   const std::map<std::string, std::string>& addParams);
     void openFile(const std::string& streamName) override;
     [[nodiscard]] const std::vector<StreamInfo>& getStreamInfo() const { return m_codecInfo; }
-    static DetectStreamRez DetectStreamReader(const BufferedReaderManager& readManager, const std::string& fileName,
-                                              bool calcDuration);
+    static DetectStreamRez DetectStreamReader(BufferedReaderManager& readManager, const std::string& fileName,
+                                              bool calcDuration, V3Info& v3Info);
     std::vector<StreamInfo>& getCodecInfo() { return m_codecInfo; }
     int getLastReadRez() override { return m_lastReadRez; }
+    void setParallelRead(const bool value) { m_parallelRead = value; }
+    //! Show the progress of the mux in the console
+    void setReportProgress(const bool value) { m_reportProgress = value; }
+    //! The packets returned from now on are processed by consumer, packets are returned directly if it is null
+    void setPacketConsumer(PacketConsumer* consumer);
     [[nodiscard]] int64_t totalSize() const { return m_totalSize; }
     static std::string mplsTrackToFullName(const std::string& mplsFileName, const std::string& mplsNum);
     static std::string mplsTrackToSSIFName(const std::string& mplsFileName, const std::string& mplsNum);
@@ -185,9 +252,21 @@ class METADemuxer final : public AbstractDemuxer
     std::chrono::steady_clock::time_point m_lastReportTime;
     int64_t m_totalSize;
     bool m_flushDataMode;
-    const BufferedReaderManager& m_readManager;
+    BufferedReaderManager& m_readManager;
+    V3Info& m_v3Info;
+    bool m_reportProgress;
     std::string m_streamName;
     std::vector<StreamInfo> m_codecInfo;
+    std::vector<std::unique_ptr<StreamReaderThread>> m_readerThreads;  // per stream, null if parsed by this thread
+    std::vector<int> m_stepStreams;  // streams whose next packet is parsed once their last packet is consumed
+    typedef std::pair<int64_t, int> StreamOrder;  // next DTS and index of a stream
+    std::priority_queue<StreamOrder, std::vector<StreamOrder>, std::greater<>> m_streamQueue;  // streams not flushed
+    std::vector<int> m_readStreams;  // sorted indexes of the streams which need to be read, see StreamInfo::needRead()
+    bool m_parallelRead;
+    PacketConsumer* m_packetConsumer;
+    int64_t m_packetCount;                 // packets returned since the consumer was set
+    int64_t m_consumedPackets;             // packets consumed, as of the last check
+    std::vector<int64_t> m_streamPackets;  // per stream, number of the last packet returned
 
     // MPLSPlayItemsMap m_mplsPlayItemsMap;
     // MPLSPlayItemsMap m_mplsStreamMap;
@@ -201,10 +280,17 @@ class METADemuxer final : public AbstractDemuxer
                                              const std::string& codecStreamName,
                                              const std::vector<MPLSPlayItem>& mplsInfo);
     inline void updateReport(bool checkTime);
+    void startReaderThreads();
+    void stopReaderThreads();
+    void initStreamQueue();
+    int readStreams(std::vector<int>& delayedStreams);
+    int nextStream(const std::vector<int>& delayedStreams);
+    bool isConsumed(int streamIndex);
+    void waitConsumed(int streamIndex);
     void lineBack();
     static CheckStreamRez detectTrackReader(uint8_t* tmpBuffer, int len,
                                             AbstractStreamReader::ContainerType containerType, int containerDataType,
-                                            int containerStreamIndex);
+                                            int containerStreamIndex, V3Info& v3Info);
     static std::string findBluRayFile(const std::string& streamDir, const std::string& requestDir,
                                       const std::string& requestFile);
     std::vector<MPLSParser> getMplsInfo(const std::string& mplsFileName);
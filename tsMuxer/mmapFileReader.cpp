@@ -0,0 +1,289 @@
+#include "mmapFileReader.h"
+
+#include <fs/systemlog.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "vod_common.h"
+
+using namespace std;
+
+namespace
+{
+constexpr int64_t WINDOW_SIZE = 64 * 1024 * 1024;
+}  // namespace
+
+// ---------------------------- MmapReaderData ------------------------------
+
+MmapReaderData::MmapReaderData()
+    : m_fd(-1), m_fileSize(0), m_filePos(0), m_window(nullptr), m_windowPos(0), m_windowSize(0), m_releasedPos(0)
+{
+}
+
+MmapReaderData::~MmapReaderData()
+{
+    if (m_fd != -1)
+        closeStream();
+}
+
+void MmapReaderData::init()
+{
+    // a single buffer is enough: it only holds the blocks which can't be returned from the mapping
+    if (m_blocks[0].m_data == nullptr)
+        m_blocks[0].m_data = new uint8_t[m_allocSize];
+}
+
+bool MmapReaderData::openStream()
+{
+    init();
+    m_fd = ::open(m_streamName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd == -1)
+        return false;
+    struct stat st;
+    m_fileSize = fstat(m_fd, &st) == 0 ? st.st_size : 0;
+    m_filePos = 0;
+    return true;
+}
+
+bool MmapReaderData::closeStream()
+{
+    unmapWindow();
+    if (m_fd == -1)
+        return false;
+    // the pages of the window are dropped from the cache only once they are unmapped
+    if (m_dropCache)
+        posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+    const bool rez = ::close(m_fd) == 0;
+    m_fd = -1;
+    return rez;
+}
+
+int MmapReaderData::readBlock(uint8_t* buffer, const uint32_t max_size)
+{
+    return m_fd == -1 ? -1 : static_cast<int>(pread(m_fd, buffer, max_size, m_filePos));
+}
+
+void MmapReaderData::unmapWindow()
+{
+    if (m_window)
+        munmap(m_window, static_cast<size_t>(m_windowSize));
+    m_window = nullptr;
+    m_windowPos = m_windowSize = m_releasedPos = 0;
+}
+
+// ---------------------------- MmapFileReader ------------------------------
+
+MmapFileReader::MmapFileReader(const uint32_t blockSize, const uint32_t allocSize, const uint32_t prereadThreshold,
+                               const uint32_t readAheadDepth)
+    : BufferedReader(blockSize, allocSize, prereadThreshold, readAheadDepth), m_pageSize(sysconf(_SC_PAGESIZE))
+{
+    // a window holds several blocks, so that it is remapped rarely
+    m_windowSize = max<int64_t>(WINDOW_SIZE, 4LL * m_allocSize);
+    m_windowSize = (m_windowSize + m_pageSize - 1) & ~(m_pageSize - 1);
+}
+
+MmapReaderData* MmapFileReader::getMmapReader(const int readerID)
+{
+    return static_cast<MmapReaderData*>(getReader(readerID));
+}
+
+bool MmapFileReader::mapWindow(MmapReaderData* data, const int64_t start) const
+{
+    data->unmapWindow();
+    const int64_t windowPos = start & ~(m_pageSize - 1);
+    const int64_t windowSize = min(m_windowSize, data->m_fileSize - windowPos);
+    // private mapping: the consumer writes in front of the blocks, these writes must not reach the file
+    void* window = mmap(nullptr, static_cast<size_t>(windowSize), PROT_READ | PROT_WRITE, MAP_PRIVATE, data->m_fd,
+                        static_cast<off_t>(windowPos));
+    if (window == MAP_FAILED)
+        return false;
+    madvise(window, static_cast<size_t>(windowSize), MADV_SEQUENTIAL);
+    data->m_window = static_cast<uint8_t*>(window);
+    data->m_windowPos = data->m_releasedPos = windowPos;
+    data->m_windowSize = windowSize;
+    return true;
+}
+
+uint8_t* MmapFileReader::mapBlock(MmapReaderData* data, const int64_t pos, uint32_t& len) const
+{
+    // The returned buffer must provide m_allocSize bytes, starting m_readOffset bytes before the block, as the
+    // buffers of the other readers do. That is not possible at the start and at the end of a file: these blocks are
+    // copied.
+    const int64_t start = pos - data->m_readOffset;
+    const int64_t end = start + m_allocSize;
+    if (len > 0 && start >= 0 && end <= data->m_fileSize &&
+        ((start >= data->m_windowPos && end <= data->m_windowPos + data->m_windowSize) || mapWindow(data, start)))
+    {
+        // the data before the block won't be accessed anymore
+        const int64_t releasePos = start & ~(m_pageSize - 1);
+        if (releasePos > data->m_releasedPos)
+        {
+            madvise(data->m_window + (data->m_releasedPos - data->m_windowPos),
+                    static_cast<size_t>(releasePos - data->m_releasedPos), MADV_DONTNEED);
+            if (data->m_dropCache)
+                posix_fadvise(data->m_fd, data->m_releasedPos, releasePos - data->m_releasedPos, POSIX_FADV_DONTNEED);
+            data->m_releasedPos = releasePos;
+        }
+        // let the kernel fetch the next blocks while this one is processed
+        const int64_t aheadPos = (pos + len) & ~(m_pageSize - 1);
+        const int64_t aheadEnd = min(pos + len + static_cast<int64_t>(getReadAheadDepth() - 1) * m_blockSize,
+                                     data->m_windowPos + data->m_windowSize);
+        if (aheadEnd > aheadPos)
+            madvise(data->m_window + (aheadPos - data->m_windowPos), static_cast<size_t>(aheadEnd - aheadPos),
+                    MADV_WILLNEED);
+        return data->m_window + (start - data->m_windowPos);
+    }
+
+    uint8_t* buffer = data->m_blocks[0].m_data;
+    if (len > 0)
+    {
+        const ssize_t rez = pread(data->m_fd, buffer + data->m_readOffset, len, static_cast<off_t>(pos));
+        if (rez != static_cast<ssize_t>(len))
+        {
+            LTRACE(LT_ERROR, 0, "Error reading file " << data->m_streamName);
+            len = static_cast<uint32_t>(max<ssize_t>(rez, 0));
+        }
+    }
+    return buffer;
+}
+
+uint8_t* MmapFileReader::readBlock(const int readerID, uint32_t& readCnt, int& rez, bool* firstBlockVar)
+{
+    MmapReaderData* data = getMmapReader(readerID);
+    if (data == nullptr)
+    {
+        rez = UNKNOWN_READERID;
+        readCnt = 0;
+        return nullptr;
+    }
+    if (data->m_blocks[0].m_data == nullptr)
+        data->init();
+    if (data->m_eofDelivered)
+    {
+        readCnt = 0;
+        rez = DATA_EOF;
+        if (firstBlockVar)
+            *firstBlockVar = false;
+        return data->m_blocks[0].m_data;
+    }
+
+    // Same sequence of blocks as BufferedReader::thread_main(), including the switch to the next file of a file list.
+    // The size of the blocks is known from the file size.
+    const uint32_t blockSize = data->m_blockSize;
+    if (data->m_lastBlock)
+    {
+        data->m_lastBlock = false;
+        data->m_firstBlock = true;
+    }
+    else if (data->m_firstBlock)
+    {
+        data->m_firstBlock = false;
+    }
+
+    const int64_t pos = data->m_filePos;
+    const int64_t bytesLeft = data->m_fd == -1 ? 0 : max<int64_t>(data->m_fileSize - pos, 0);
+    uint32_t len = static_cast<uint32_t>(min<int64_t>(blockSize, bytesLeft));
+    uint8_t* buffer = mapBlock(data, pos, len);
+    data->m_filePos = pos + len;
+
+    bool eof = false;
+    if (len == 0 || (len < blockSize && data->itr))
+    {
+        if (data->itr)
+        {
+            const std::string nextFileName = data->itr->getNextName();
+            if (nextFileName != data->m_streamName)
+            {
+                // a partial block is always copied, so the current file can be closed
+                data->closeStream();
+                data->m_streamName = nextFileName;
+                if (!data->m_streamName.empty() && data->openStream())
+                {
+                    if (len == 0)
+                    {
+                        data->m_firstBlock = true;
+                        len = static_cast<uint32_t>(min<int64_t>(m_blockSize, data->m_fileSize));
+                        buffer = mapBlock(data, 0, len);
+                        data->m_filePos = len;
+                        if (len < m_blockSize)
+                        {
+                            eof = true;
+                            data->m_lastBlock = true;
+                        }
+                    }
+                    else
+                    {
+                        data->m_lastBlock = true;
+                    }
+                }
+                else
+                    eof = true;
+            }
+        }
+        else
+        {
+            eof = true;
+        }
+    }
+
+    data->m_blockSize = m_blockSize;
+    if (len == 0)
+        eof = true;
+
+    readCnt = len;
+    rez = eof ? DATA_EOF : 0;
+    if (firstBlockVar)
+        *firstBlockVar = data->m_firstBlock;
+    data->m_eofDelivered = eof;
+    return buffer;
+}
+
+void MmapFileReader::notify(int readerID, uint32_t dataReaded)
+{
+    // nothing to do: the next blocks are prefetched by the kernel
+}
+
+bool MmapFileReader::incSeek(const int readerID, const int64_t offset)
+{
+    MmapReaderData* data = getMmapReader(readerID);
+    if (data == nullptr || data->m_fd == -1 || data->m_filePos + offset < 0)
+        return false;
+    // the mapping is dropped: blocks read again must not contain the data written by the consumer
+    data->unmapWindow();
+    data->m_filePos += offset;
+    data->m_eofDelivered = false;
+    return true;
+}
+
+bool MmapFileReader::gotoByte(const int readerID, const int64_t seekDist)
+{
+    MmapReaderData* data = getMmapReader(readerID);
+    if (data == nullptr || data->m_fd == -1 || seekDist < 0)
+        return false;
+    data->unmapWindow();
+    data->m_blockSize = m_blockSize - static_cast<uint32_t>(seekDist % static_cast<uint64_t>(m_blockSize));
+    data->m_filePos = seekDist;
+    data->m_eofDelivered = false;
+    return true;
+}
+
+bool MmapFileReader::openStream(const int readerID, const char* streamName, int pid, const CodecInfo* codecInfo)
+{
+    MmapReaderData* data = getMmapReader(readerID);
+    if (data == nullptr)
+    {
+        LTRACE(LT_ERROR, 0, "Unknown readerID " << readerID);
+        return false;
+    }
+    data->resetBlocks();
+    data->m_firstBlock = true;
+    data->m_lastBlock = false;
+    data->m_streamName = streamName;
+    data->closeStream();
+    return data->openStream();
+}
@@ -0,0 +1,60 @@
+#ifndef MMAP_FILE_READER_H_
+#define MMAP_FILE_READER_H_
+
+#include "bufferedReader.h"
+
+// Reader data for the memory mapped reader. The blocks returned to the consumer point into a window of the file
+// mapped in memory, only the first and the last block of a file are copied into a regular buffer.
+struct MmapReaderData final : ReaderData
+{
+    MmapReaderData();
+    ~MmapReaderData() override;
+
+    void init() override;
+    bool openStream() override;
+    bool closeStream() override;
+    // reads max_size bytes at the current position, without moving it
+    int readBlock(uint8_t* buffer, uint32_t max_size) override;
+
+    void unmapWindow();
+
+    int m_fd;
+    int64_t m_fileSize;
+    int64_t m_filePos;  // offset of the next block
+    uint8_t* m_window;
+    int64_t m_windowPos;
+    int64_t m_windowSize;
+    int64_t m_releasedPos;  // the pages of the window before this offset have been released
+};
+
+// AbstractReader implementation which maps the input files in memory instead of reading them. The data is paged in
+// by the kernel read-ahead, so there is no reader thread and no copy of the data between the page cache and the
+// block buffers. Blocks are mapped privately and writable, but only the m_readOffset bytes in front of a block may
+// be written: the bytes after readCnt are the data of the next block. A block is only valid until the next call of
+// readBlock(), which may unmap the window holding it. Consumers which need more must copy the block.
+class MmapFileReader final : public BufferedReader
+{
+   public:
+    MmapFileReader(uint32_t blockSize, uint32_t allocSize = 0, uint32_t prereadThreshold = 0,
+                   uint32_t readAheadDepth = DEFAULT_READ_AHEAD_DEPTH);
+
+    uint8_t* readBlock(int readerID, uint32_t& readCnt, int& rez, bool* firstBlockVar = nullptr) override;
+    void notify(int readerID, uint32_t dataReaded) override;
+    bool incSeek(int readerID, int64_t offset) override;
+    bool gotoByte(int readerID, int64_t seekDist) override;
+    bool openStream(int readerID, const char* streamName, int pid = 0, const CodecInfo* codecInfo = nullptr) override;
+
+   protected:
+    ReaderData* intCreateReader() override { return new MmapReaderData(); }
+    void thread_main() override {}
+
+   private:
+    MmapReaderData* getMmapReader(int readerID);
+    uint8_t* mapBlock(MmapReaderData* data, int64_t pos, uint32_t& len) const;
+    bool mapWindow(MmapReaderData* data, int64_t start) const;
+
+    int64_t m_pageSize;
+    int64_t m_windowSize;
+};
+
+#endif
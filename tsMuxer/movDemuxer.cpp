@@ -607,8 +607,8 @@ class MovParsedSRTTrackData final : public ParsedTrackPrivData
     int64_t m_timeOffset;
 };
 
-MovDemuxer::MovDemuxer(const BufferedReaderManager& readManager)
-    : IOContextDemuxer(readManager), m_mdat_size(0), m_fileSize(0), m_timescale(0), fragment()
+MovDemuxer::MovDemuxer(BufferedReaderManager& readManager, const char* streamName)
+    : IOContextDemuxer(readManager, streamName), m_mdat_size(0), m_fileSize(0), m_timescale(0), fragment()
 {
     found_moov = 0;
     found_moof = false;
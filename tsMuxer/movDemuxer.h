@@ -12,7 +12,7 @@
 class MovDemuxer final : public IOContextDemuxer
 {
    public:
-    MovDemuxer(const BufferedReaderManager& readManager);
+    MovDemuxer(BufferedReaderManager& readManager, const char* streamName = "");
     ~MovDemuxer() override { readClose(); }
     void openFile(const std::string& streamName) override;
     void readClose() override;
@@ -1,6 +1,8 @@
 #include "muxerManager.h"
 
+#include <algorithm>
 #include <cmath>
+#include <thread>
 
 #include <fs/systemlog.h>
 #include "fs/textfile.h"
@@ -14,6 +16,7 @@ using namespace std;
 
 // static const int SSIF_INTERLEAVE_BLOCKSIZE = 1024 * 1024 * 7;
 static constexpr int MAX_FRAME_SIZE = 1200000;  // 1.2m
+static constexpr int MUX_QUEUE_SIZE = 256;      // packets parsed ahead of the muxer thread
 
 namespace
 {
@@ -39,8 +42,14 @@ int seekDefaultTrack(const std::vector<StreamInfo>& tracks, std::string& param,
 }
 }  // namespace
 
-MuxerManager::MuxerManager(const BufferedReaderManager& readManager, AbstractMuxerFactory& factory)
-    : m_metaDemuxer(readManager), m_factory(factory)
+MuxerManager::MuxerManager(BufferedReaderManager& readManager, AbstractMuxerFactory& factory, V3Info& v3Info,
+                           OutputBlockPool* outputBlockPool)
+    : m_metaDemuxer(readManager, v3Info),
+      m_ownOutputBlockPool(
+          outputBlockPool ? nullptr : std::make_unique<OutputBlockPool>(OUTPUT_BLOCK_SIZE, OUTPUT_BLOCK_POOL_SIZE)),
+      m_outputBlockPool(outputBlockPool ? outputBlockPool : m_ownOutputBlockPool.get()),
+      m_factory(factory),
+      m_v3Info(v3Info)
 {
     m_asyncMode = true;
     m_fileWriter = nullptr;
@@ -60,6 +69,7 @@ MuxerManager::MuxerManager(const BufferedReaderManager& readManager, AbstractMux
 
 MuxerManager::~MuxerManager()
 {
+    m_muxerPipeline.reset();
     delete m_mainMuxer;
     delete m_subMuxer;
 }
@@ -134,6 +144,7 @@ void MuxerManager::preinitMux(const std::string& outFileName, FileFactory* fileF
     {
         m_subMuxer->setSubMode(m_mainMuxer, mvcTrackFirst);
         m_mainMuxer->setMasterMode(m_subMuxer, !mvcTrackFirst);
+        m_blockSwitchMuxer = mvcTrackFirst ? m_subMuxer : m_mainMuxer;
     }
 
     for (StreamInfo& si : ci)
@@ -195,7 +206,7 @@ void MuxerManager::checkTrackList(const vector<StreamInfo>& ci) const
         else if (m_bluRayMode && mlpFound)
             LTRACE(LT_ERROR, 2,
                    "Warning! MLP codec is not standard for BD disks, the disk will not play in a Blu-ray player.");
-        else if (m_bluRayMode && (V3_flags & DV) && !(V3_flags & BL_TRACK))
+        else if (m_bluRayMode && (m_v3Info.flags() & DV) && !(m_v3Info.flags() & BL_TRACK))
             LTRACE(LT_ERROR, 2,
                    "Warning! Dolby Vision Double Layer Single Tracks are not standard for BD disks, the disk will "
                    "not play in a Blu-ray player.");
@@ -209,8 +220,10 @@ void MuxerManager::doMux(const string& outFileName, FileFactory* fileFactory)
 {
     preinitMux(outFileName, fileFactory);
 
-    m_fileWriter = new BufferedFileWriter();
+    m_fileWriter = new BufferedFileWriter(m_outputBlockPool->maxBlocks());
     AVPacket avPacket;
+    if (m_asyncMode && m_parallelMux)
+        m_muxerPipeline = std::make_unique<MuxerPipeline>(m_metaDemuxer, m_mainMuxer, m_subMuxer, m_blockSwitchMuxer);
 
     while (true)
     {
@@ -218,18 +231,25 @@ void MuxerManager::doMux(const string& outFileName, FileFactory* fileFactory)
 
         if (avRez == BufferedReader::DATA_EOF)
             break;
-        if (m_cutStart > 0)
-        {
-            if (avPacket.pts < m_cutStart)
-                continue;
-        }
-        if (m_cutEnd > 0 && avPacket.pts >= m_cutEnd)
+        if (avRez != 0)
+            continue;  // no packet, the data isn't ready
+        const bool skipPacket = m_cutStart > 0 && avPacket.pts < m_cutStart;
+        if (!skipPacket && m_cutEnd > 0 && avPacket.pts >= m_cutEnd)
             break;
 
-        if (m_subStreamIndex.find(avPacket.stream_index) != m_subStreamIndex.end())
-            m_subMuxer->muxPacket(avPacket);
-        else
-            m_mainMuxer->muxPacket(avPacket);
+        AbstractMuxer* muxer = nullptr;
+        if (!skipPacket)
+            muxer = m_subStreamIndex.find(avPacket.stream_index) != m_subStreamIndex.end() ? m_subMuxer : m_mainMuxer;
+
+        if (m_muxerPipeline)
+            m_muxerPipeline->addPacket(avPacket, muxer);  // the demuxer counts the packets it returns, skipped ones too
+        else if (muxer)
+            muxer->muxPacket(avPacket);
+    }
+    if (m_muxerPipeline)
+    {
+        m_muxerPipeline->finish();
+        m_muxerPipeline.reset();
     }
 
     LTRACE(LT_INFO, 2, "Flushing write buffer");
@@ -280,6 +300,7 @@ bool MuxerManager::openMetaFile(const string& fileName)
 
 void MuxerManager::muxBlockFinished(const AbstractMuxer* muxer)
 {
+    std::lock_guard lk(m_delayedMtx);
     if (muxer == m_subMuxer)
         m_subBlockFinished = true;
     else
@@ -295,18 +316,32 @@ void MuxerManager::muxBlockFinished(const AbstractMuxer* muxer)
     }
 }
 
+void MuxerManager::beginBlockSwitch(const AbstractMuxer* muxer) const
+{
+    if (m_muxerPipeline)
+        m_muxerPipeline->beginBlockSwitch(muxer);
+}
+
+void MuxerManager::endBlockSwitch(const AbstractMuxer* muxer) const
+{
+    if (m_muxerPipeline)
+        m_muxerPipeline->endBlockSwitch(muxer);
+}
+
 void MuxerManager::asyncWriteBuffer(const AbstractMuxer* muxer, uint8_t* buff, const int len,
-                                    AbstractOutputStream* dstFile)
+                                    AbstractOutputStream* dstFile, OutputBlockPool* pool)
 {
     WriterData data;
     data.m_buffer = buff;
     data.m_bufferLen = len;
     data.m_mainFile = dstFile;
     data.m_command = WriterData::Commands::wdWrite;
+    data.m_pool = pool;
 
     if (m_interleave && muxer == m_mainMuxer)
     {
         // do interleave of SSIF blocks. Place sub channel blocks first, delay main muxer blocks
+        std::lock_guard lk(m_delayedMtx);
         m_delayedData.push_back(data);
         return;
     }
@@ -316,12 +351,11 @@ void MuxerManager::asyncWriteBuffer(const AbstractMuxer* muxer, uint8_t* buff, c
 
 void MuxerManager::asyncWriteBlock(const WriterData& data) const
 {
-    static constexpr int nMaxWriteQueueSize = 256 * 1024 * 1024 / DEFAULT_FILE_BLOCK_SIZE;
-    while (m_fileWriter->getQueueSize() > nMaxWriteQueueSize)
-    {
-        Process::sleep(1);
-    }
-    m_fileWriter->addWriterData(data);
+    // the queue can't be full: each queued block is a block of the pool, which bounds the data queued
+    std::lock_guard lk(m_writeMtx);
+    const bool queued = m_fileWriter->addWriterData(data);
+    assert(queued);
+    (void)queued;
 }
 
 int MuxerManager::syncWriteBuffer(AbstractMuxer* muxer, const uint8_t* buff, const int len,
@@ -379,6 +413,9 @@ void MuxerManager::parseMuxOpt(const string& opts)
         {
             if (m_extraIsoBlocks == 0)
                 m_extraIsoBlocks = 4;
+            // a split resets the state of all stream readers, it must not happen while they parse ahead
+            m_metaDemuxer.setParallelRead(false);
+            m_parallelMux = false;
         }
         else if (paramPair[0] == "--extra-iso-space")
         {
@@ -396,9 +433,27 @@ void MuxerManager::parseMuxOpt(const string& opts)
         {
             m_reproducibleIsoHeader = true;
         }
+        else if (paramPair[0] == "--direct-io")
+        {
+            m_directIO = true;
+        }
+        else if (paramPair[0] == "--drop-cache")
+        {
+            m_dropCache = true;
+        }
     }
 }
 
+unsigned MuxerManager::getOutputFileFlags() const
+{
+    unsigned oflag = File::ofWrite;
+    if (m_directIO)
+        oflag += File::ofDirectIO;
+    if (m_dropCache)
+        oflag += File::ofDropCache;
+    return oflag;
+}
+
 void MuxerManager::waitForWriting() const
 {
     while (!m_fileWriter->isQueueEmpty()) Process::sleep(1);
@@ -444,3 +499,226 @@ int MuxerManager::getDefaultSubTrackIdx(SubTrackMode& mode) const
     }
     return idx;
 }
+
+// ---------------------------- MuxerThread ------------------------------
+
+MuxerThread::MuxerThread(MuxerPipeline& pipeline, AbstractMuxer* muxer)
+    : m_pipeline(pipeline),
+      m_muxer(muxer),
+      m_sibling(nullptr),
+      m_siblingSwitchesBlocks(false),
+      m_queue(MUX_QUEUE_SIZE),
+      m_packetNum(0),
+      m_muxed(0),
+      m_checked(0),
+      m_finished(false)
+{
+    run(this);
+}
+
+MuxerThread::~MuxerThread() { finish(); }
+
+void MuxerThread::setSibling(MuxerThread* sibling, const bool siblingSwitchesBlocks)
+{
+    // the thread doesn't read these fields before the first packet is queued
+    m_sibling = sibling;
+    m_siblingSwitchesBlocks = siblingSwitchesBlocks;
+}
+
+void MuxerThread::addPacket(const MuxerPacket& muxerPacket)
+{
+    while (!m_queue.push(muxerPacket))
+    {
+        // the queue is full: wait for the next packet to be processed
+        std::unique_lock lk(m_mtx);
+        const int64_t muxed = m_muxed.load(std::memory_order_relaxed);
+        m_cond.wait(lk, [&] { return m_muxed.load(std::memory_order_relaxed) != muxed; });
+    }
+}
+
+void MuxerThread::finish()
+{
+    if (m_finished)
+        return;
+    MuxerPacket lastPacket;
+    lastPacket.m_last = true;
+    addPacket(lastPacket);
+    join();
+    m_finished = true;
+}
+
+int64_t MuxerThread::waitMuxed(const int64_t packetCount)
+{
+    const int64_t muxed = m_muxed.load(std::memory_order_acquire);
+    if (muxed >= packetCount)
+        return muxed;
+    std::unique_lock lk(m_mtx);
+    m_cond.wait(lk, [&] { return m_muxed.load(std::memory_order_relaxed) >= packetCount; });
+    return m_muxed.load(std::memory_order_relaxed);
+}
+
+void MuxerThread::waitChecked(const int64_t packetCount)
+{
+    if (m_checked.load(std::memory_order_acquire) >= packetCount)
+        return;
+    std::unique_lock lk(m_mtx);
+    m_cond.wait(lk, [&] { return m_checked.load(std::memory_order_relaxed) >= packetCount; });
+}
+
+void MuxerThread::beginBlockSwitch()
+{
+    if (m_sibling)
+        m_sibling->waitMuxed(m_packetNum - 1);
+}
+
+void MuxerThread::endBlockSwitch()
+{
+    {
+        std::lock_guard lk(m_mtx);
+        m_checked.store(m_packetNum, std::memory_order_release);
+    }
+    m_cond.notify_all();
+}
+
+void MuxerThread::thread_main()
+{
+    while (true)
+    {
+        MuxerPacket muxerPacket = m_queue.pop();
+        if (muxerPacket.m_last)
+            return;
+        const int64_t packetNum = m_muxed.load(std::memory_order_relaxed) + 1;
+        if (!m_pipeline.isStopped())
+        {
+            try
+            {
+                if (m_muxer == nullptr)
+                {
+                    if (muxerPacket.m_muxer)
+                        muxerPacket.m_muxer->muxPacket(muxerPacket.m_packet);
+                }
+                else if (muxerPacket.m_muxer == m_muxer)
+                {
+                    // the sibling may finish the block of this muxer while it muxes its own packets
+                    if (m_siblingSwitchesBlocks)
+                        m_sibling->waitChecked(packetNum - 1);
+                    m_packetNum = packetNum;
+                    m_muxer->muxPacket(muxerPacket.m_packet);
+                }
+            }
+            catch (...)
+            {
+                m_pipeline.setError(std::current_exception());
+            }
+        }
+        {
+            std::lock_guard lk(m_mtx);
+            m_checked.store(packetNum, std::memory_order_relaxed);
+            m_muxed.store(packetNum, std::memory_order_release);
+        }
+        m_cond.notify_all();
+    }
+}
+
+// ---------------------------- MuxerPipeline ------------------------------
+
+MuxerPipeline::MuxerPipeline(METADemuxer& demuxer, AbstractMuxer* mainMuxer, AbstractMuxer* subMuxer,
+                             const AbstractMuxer* blockSwitchMuxer)
+    : m_demuxer(demuxer), m_stopped(false), m_finished(false)
+{
+    // the muxers only run concurrently on several cores, they would mostly wait for each other otherwise
+    if (subMuxer == nullptr || std::thread::hardware_concurrency() < 2)
+    {
+        m_threads.push_back(std::make_unique<MuxerThread>(*this, nullptr));
+    }
+    else
+    {
+        m_threads.push_back(std::make_unique<MuxerThread>(*this, mainMuxer));
+        m_threads.push_back(std::make_unique<MuxerThread>(*this, subMuxer));
+        MuxerThread* mainThread = m_threads[0].get();
+        MuxerThread* subThread = m_threads[1].get();
+        mainThread->setSibling(subThread, blockSwitchMuxer == subMuxer);
+        subThread->setSibling(mainThread, blockSwitchMuxer == mainMuxer);
+    }
+    m_demuxer.setPacketConsumer(this);
+}
+
+MuxerPipeline::~MuxerPipeline()
+{
+    // on an error of the demuxer the queued packets are dropped
+    if (!m_finished)
+        m_stopped = true;
+    m_threads.clear();
+    m_demuxer.setPacketConsumer(nullptr);
+}
+
+void MuxerPipeline::setError(const std::exception_ptr& error)
+{
+    std::lock_guard lk(m_errorMtx);
+    if (!m_error)
+        m_error = error;
+    m_stopped = true;
+}
+
+void MuxerPipeline::checkError()
+{
+    if (m_stopped)
+    {
+        std::lock_guard lk(m_errorMtx);
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+}
+
+MuxerThread* MuxerPipeline::getThread(const AbstractMuxer* muxer) const
+{
+    for (const auto& thread : m_threads)
+        if (thread->muxer() == muxer)
+            return thread.get();
+    return nullptr;
+}
+
+void MuxerPipeline::addPacket(const AVPacket& avPacket, AbstractMuxer* muxer)
+{
+    checkError();
+    MuxerThread::MuxerPacket muxerPacket;
+    muxerPacket.m_packet = avPacket;
+    muxerPacket.m_muxer = muxer;
+    for (const auto& thread : m_threads) thread->addPacket(muxerPacket);
+}
+
+void MuxerPipeline::finish()
+{
+    for (const auto& thread : m_threads) thread->finish();
+    m_finished = true;
+    checkError();
+}
+
+int64_t MuxerPipeline::consumedPackets() const
+{
+    // a packet is consumed once all threads have processed it
+    int64_t rez = m_threads[0]->muxedPackets();
+    for (size_t i = 1; i < m_threads.size(); i++) rez = std::min(rez, m_threads[i]->muxedPackets());
+    return rez;
+}
+
+int64_t MuxerPipeline::waitConsumed(const int64_t packetCount)
+{
+    for (const auto& thread : m_threads) thread->waitMuxed(packetCount);
+    checkError();
+    return consumedPackets();
+}
+
+void MuxerPipeline::beginBlockSwitch(const AbstractMuxer* muxer) const
+{
+    MuxerThread* thread = getThread(muxer);
+    if (thread)
+        thread->beginBlockSwitch();
+}
+
+void MuxerPipeline::endBlockSwitch(const AbstractMuxer* muxer) const
+{
+    MuxerThread* thread = getThread(muxer);
+    if (thread)
+        thread->endBlockSwitch();
+}
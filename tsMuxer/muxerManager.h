@@ -1,12 +1,116 @@
 #ifndef MUXER_MANAGER_H_
 #define MUXER_MANAGER_H_
 
+#include <containers/spscqueue.h>
+#include <system/terminatablethread.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "abstractMuxer.h"
 #include "bufferedFileWriter.h"
 #include "bufferedReaderManager.h"
 #include "metaDemuxer.h"
 
 class FileFactory;
+class V3Info;
+
+class MuxerPipeline;
+
+// Muxes the packets of a muxer on a thread of its own. All packets returned by the demuxer are queued to every muxer
+// thread, the packets of the other muxers are only counted: the threads agree on the number of each packet.
+class MuxerThread final : public TerminatableThread
+{
+   public:
+    struct MuxerPacket
+    {
+        AVPacket m_packet;
+        AbstractMuxer* m_muxer = nullptr;  // null if the packet is skipped
+        bool m_last = false;               // no packet follows, the thread ends
+    };
+
+    //! The thread muxes the packets of all muxers if muxer is null
+    MuxerThread(MuxerPipeline& pipeline, AbstractMuxer* muxer);
+    ~MuxerThread() override;
+
+    [[nodiscard]] AbstractMuxer* muxer() const { return m_muxer; }
+    //! sibling is the thread of the other muxer of an interleaved output. If siblingSwitchesBlocks is set, the sibling
+    //! finishes the interleaved blocks of both muxers: before this thread muxes a packet, the sibling must have checked
+    //! the blocks at all previous packets.
+    void setSibling(MuxerThread* sibling, bool siblingSwitchesBlocks);
+
+    void addPacket(const MuxerPacket& muxerPacket);
+    //! Waits until the queued packets are processed and ends the thread
+    void finish();
+    [[nodiscard]] int64_t muxedPackets() const { return m_muxed.load(std::memory_order_acquire); }
+    //! Waits until at least packetCount packets are processed
+    int64_t waitMuxed(int64_t packetCount);
+
+    //! Called by the muxer before it checks the blocks: waits until the sibling has processed the previous packets
+    void beginBlockSwitch();
+    //! Called by the muxer once the blocks are checked: the sibling may go on
+    void endBlockSwitch();
+
+   protected:
+    void thread_main() override;
+
+   private:
+    void waitChecked(int64_t packetCount);
+
+    MuxerPipeline& m_pipeline;
+    AbstractMuxer* m_muxer;
+    MuxerThread* m_sibling;
+    bool m_siblingSwitchesBlocks;
+    SpscQueue<MuxerPacket> m_queue;
+    int64_t m_packetNum;             // number of the packet being muxed
+    std::atomic<int64_t> m_muxed;    // number of packets processed
+    std::atomic<int64_t> m_checked;  // number of packets whose blocks are checked, at least m_muxed
+    std::mutex m_mtx;
+    std::condition_variable m_cond;
+    bool m_finished;
+};
+
+// Hands the packets returned by the demuxer to a MuxerThread per muxer, so that the next packets are parsed while the
+// previous ones are muxed. For a stereoscopic output the main and the sub muxer run concurrently on a multi-core CPU:
+// they meet when the interleaved blocks are checked, the muxer which switches the blocks finishes the blocks of both.
+class MuxerPipeline final : public PacketConsumer
+{
+   public:
+    //! subMuxer may be null. blockSwitchMuxer is the muxer which finishes the interleaved blocks, if any
+    MuxerPipeline(METADemuxer& demuxer, AbstractMuxer* mainMuxer, AbstractMuxer* subMuxer,
+                  const AbstractMuxer* blockSwitchMuxer);
+    ~MuxerPipeline() override;
+
+    //! Queues a packet for muxer. The packet is only counted as consumed if muxer is null
+    void addPacket(const AVPacket& avPacket, AbstractMuxer* muxer);
+    //! Waits until all queued packets are muxed
+    void finish();
+
+    [[nodiscard]] int64_t consumedPackets() const override;
+    int64_t waitConsumed(int64_t packetCount) override;
+
+    void beginBlockSwitch(const AbstractMuxer* muxer) const;
+    void endBlockSwitch(const AbstractMuxer* muxer) const;
+
+    //! The next packets are only counted as consumed
+    [[nodiscard]] bool isStopped() const { return m_stopped; }
+    void setError(const std::exception_ptr& error);
+
+   private:
+    void checkError();
+    [[nodiscard]] MuxerThread* getThread(const AbstractMuxer* muxer) const;
+
+    METADemuxer& m_demuxer;
+    std::vector<std::unique_ptr<MuxerThread>> m_threads;
+    std::atomic<bool> m_stopped;
+    std::mutex m_errorMtx;
+    std::exception_ptr m_error;
+    bool m_finished;
+};
 
 class MuxerManager final
 {
@@ -16,12 +120,18 @@ class MuxerManager final
     static constexpr int BLURAY_SECTOR_SIZE =
         PHYSICAL_SECTOR_SIZE * 3;  // real sector size is 2048, but M2TS frame required addition rounding by 3 blocks
 
-    MuxerManager(const BufferedReaderManager& readManager, AbstractMuxerFactory& factory);
+    //! v3Info is the Blu-ray V3 state of the mux job, it may be shared by several muxer managers of the job. The
+    //! output blocks are taken from outputBlockPool if set, which may be shared by several jobs, from a pool of the
+    //! muxer manager otherwise.
+    MuxerManager(BufferedReaderManager& readManager, AbstractMuxerFactory& factory, V3Info& v3Info,
+                 OutputBlockPool* outputBlockPool = nullptr);
     ~MuxerManager();
 
     void setAsyncMode(const bool val) { m_asyncMode = val; }
 
     [[nodiscard]] bool isAsyncMode() const { return m_asyncMode; }
+    //! Show the progress of the mux in the console, on by default
+    void setReportProgress(const bool value) { m_metaDemuxer.setReportProgress(value); }
 
     bool openMetaFile(const std::string& fileName);
     int addStream(const std::string& codecName, const std::string& fileName,
@@ -37,9 +147,14 @@ class MuxerManager final
 
     void waitForWriting() const;
 
-    void asyncWriteBuffer(const AbstractMuxer* muxer, uint8_t* buff, int len, AbstractOutputStream* dstFile);
+    // buff is a block of pool, it is returned to the pool after writing
+    void asyncWriteBuffer(const AbstractMuxer* muxer, uint8_t* buff, int len, AbstractOutputStream* dstFile,
+                          OutputBlockPool* pool);
     int syncWriteBuffer(AbstractMuxer* muxer, const uint8_t* buff, int len, AbstractOutputStream* dstFile) const;
     void muxBlockFinished(const AbstractMuxer* muxer);
+    // called by a muxer around the check of the interleaved blocks, see MuxerPipeline
+    void beginBlockSwitch(const AbstractMuxer* muxer) const;
+    void endBlockSwitch(const AbstractMuxer* muxer) const;
 
     void parseMuxOpt(const std::string& opts);
     int getTrackCnt() { return static_cast<int>(m_metaDemuxer.getCodecInfo().size()); }
@@ -47,6 +162,7 @@ class MuxerManager final
     [[nodiscard]] AbstractMuxer* getMainMuxer() const;
     [[nodiscard]] AbstractMuxer* getSubMuxer() const;
     [[nodiscard]] bool isStereoMode() const;
+    [[nodiscard]] V3Info& v3Info() const { return m_v3Info; }
 
     void setAllowStereoMux(bool value);
 
@@ -55,6 +171,9 @@ class MuxerManager final
     [[nodiscard]] int getExtraISOBlocks() const { return m_extraIsoBlocks; }
 
     [[nodiscard]] bool useReproducibleIsoHeader() const { return m_reproducibleIsoHeader; }
+    // open flags of the output files
+    [[nodiscard]] unsigned getOutputFileFlags() const;
+    [[nodiscard]] OutputBlockPool* getOutputBlockPool() const { return m_outputBlockPool; }
 
     enum class SubTrackMode
     {
@@ -82,21 +201,33 @@ class MuxerManager final
     int64_t m_cutStart;
     int64_t m_cutEnd;
     BufferedFileWriter* m_fileWriter;
+    std::unique_ptr<OutputBlockPool> m_ownOutputBlockPool;  // null if the pool is shared
+    OutputBlockPool* m_outputBlockPool;
     AbstractMuxerFactory& m_factory;
+    V3Info& m_v3Info;
     bool m_allowStereoMux;
     std::set<int> m_subStreamIndex;
     std::string m_muxOpts;
     bool m_interleave;
 
-    std::vector<WriterData> m_delayedData;  // ssif interlieave
+    // ssif interlieave. The main muxer delays its blocks while the block switch of the other muxer thread may flush
+    // them, so these members are guarded by m_delayedMtx, which is taken before m_writeMtx
+    std::vector<WriterData> m_delayedData;
     bool m_subBlockFinished;
     bool m_mainBlockFinished;
+    std::mutex m_delayedMtx;
     bool m_mvcBaseViewR;
     int64_t m_ptsOffset;
     int m_extraIsoBlocks;
     bool m_bluRayMode;
     bool m_demuxMode;
     bool m_reproducibleIsoHeader = false;
+    bool m_directIO = false;
+    bool m_dropCache = false;
+    bool m_parallelMux = true;  // the packets are muxed by a MuxerPipeline in async mode
+    std::unique_ptr<MuxerPipeline> m_muxerPipeline;
+    const AbstractMuxer* m_blockSwitchMuxer = nullptr;  // the muxer which finishes the interleaved blocks
+    mutable std::mutex m_writeMtx;                      // the muxer threads queue data for writing concurrently
 };
 
 #endif  // _MUXER_MANAGER_H_
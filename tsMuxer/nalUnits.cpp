@@ -7,6 +7,7 @@
 
 #include "bitStream.h"
 #include "nalUnits.h"
+#include "startCode.h"
 #include "vod_common.h"
 
 static constexpr uint8_t BDROM_METADATA_GUID[] = "\x17\xee\x8c\x60\xf8\x4d\x11\xd9\x8c\xd6\x08\x00\x20\x0c\x9a\x66";
@@ -60,74 +61,42 @@ uint8_t* NALUnit::addStartCode(uint8_t* buffer, const uint8_t* boundStart)
 
 uint8_t* NALUnit::findNextNAL(uint8_t* buffer, uint8_t* end)
 {
-    for (buffer += 2; buffer < end;)
-    {
-        if (*buffer > 1)
-            buffer += 3;
-        else if (*buffer == 0)
-            buffer++;
-        else  // *buffer == 1
-        {
-            if (buffer[-2] == 0 && buffer[-1] == 0)
-                return buffer + 1;
-            buffer += 3;
-        }
-    }
-    return end;
+    uint8_t* startCode = findStartCode(buffer, end);
+    return startCode == end ? end : startCode + 3;
 }
 
 uint8_t* NALUnit::findNALWithStartCode(uint8_t* buffer, uint8_t* end, const bool longCodesAllowed)
 {
-    const uint8_t* bufStart = buffer;
-    for (buffer += 2; buffer < end;)
-    {
-        if (*buffer > 1)
-            buffer += 3;
-        else if (*buffer == 0)
-            buffer++;
-        else  // *buffer == 1
-        {
-            if (buffer[-2] == 0 && buffer[-1] == 0)
-            {
-                if (longCodesAllowed && buffer - 3 >= bufStart && buffer[-3] == 0)
-                    return buffer - 3;
-                return buffer - 2;
-            }
-            buffer += 3;
-        }
-    }
-    return end;
+    uint8_t* startCode = findStartCode(buffer, end);
+    if (longCodesAllowed && startCode != end && startCode > buffer && startCode[-1] == 0)
+        return startCode - 1;
+    return startCode;
 }
 
 int NALUnit::encodeNAL(const uint8_t* srcBuffer, const uint8_t* srcEnd, uint8_t* dstBuffer, size_t dstBufferSize)
 {
     const uint8_t* srcStart = srcBuffer;
     const uint8_t* initDstBuffer = dstBuffer;
-    for (srcBuffer += 2; srcBuffer < srcEnd;)
+    // the runs of bytes between the positions to escape are copied as they are
+    for (srcBuffer = findEscapePos(srcBuffer + 2, srcEnd); srcBuffer < srcEnd;
+         srcBuffer = findEscapePos(srcBuffer, srcEnd))
     {
-        if (*srcBuffer > 3)
-            srcBuffer += 3;
-        else if (srcBuffer[-2] == 0 && srcBuffer[-1] == 0)
+        if (dstBufferSize < static_cast<size_t>(srcBuffer - srcStart + 2))
+            return -1;
+        memcpy(dstBuffer, srcStart, srcBuffer - srcStart);
+        dstBuffer += srcBuffer - srcStart;
+        dstBufferSize -= srcBuffer - srcStart + 2;
+        *dstBuffer++ = 3;
+        *dstBuffer++ = *srcBuffer++;
+
+        if (srcBuffer < srcEnd)
         {
-            if (dstBufferSize < static_cast<size_t>(srcBuffer - srcStart + 2))
+            if (dstBufferSize < 1)
                 return -1;
-            memcpy(dstBuffer, srcStart, srcBuffer - srcStart);
-            dstBuffer += srcBuffer - srcStart;
-            dstBufferSize -= srcBuffer - srcStart + 2;
-            *dstBuffer++ = 3;
             *dstBuffer++ = *srcBuffer++;
-
-            if (srcBuffer < srcEnd)
-            {
-                if (dstBufferSize < 1)
-                    return -1;
-                *dstBuffer++ = *srcBuffer++;
-                dstBufferSize--;
-            }
-            srcStart = srcBuffer;
+            dstBufferSize--;
         }
-        else
-            srcBuffer++;
+        srcStart = srcBuffer;
     }
     if (dstBufferSize < static_cast<size_t>(srcEnd - srcStart))
         return -1;
@@ -140,22 +109,16 @@ int NALUnit::decodeNAL(const uint8_t* srcBuffer, const uint8_t* srcEnd, uint8_t*
 {
     const uint8_t* initDstBuffer = dstBuffer;
     const uint8_t* srcStart = srcBuffer;
-    for (srcBuffer += 3; srcBuffer < srcEnd;)
+    for (srcBuffer = findUnescapePos(srcBuffer + 3, srcEnd); srcBuffer < srcEnd;
+         srcBuffer = findUnescapePos(srcBuffer, srcEnd))
     {
-        if (*srcBuffer > 3)
-            srcBuffer += 4;
-        else if (srcBuffer[-3] == 0 && srcBuffer[-2] == 0 && srcBuffer[-1] == 3)
-        {
-            if (dstBufferSize < static_cast<size_t>(srcBuffer - srcStart))
-                return -1;
-            memcpy(dstBuffer, srcStart, srcBuffer - srcStart - 1);
-            dstBuffer += srcBuffer - srcStart - 1;
-            dstBufferSize -= srcBuffer - srcStart;
-            *dstBuffer++ = *srcBuffer++;
-            srcStart = srcBuffer;
-        }
-        else
-            srcBuffer++;
+        if (dstBufferSize < static_cast<size_t>(srcBuffer - srcStart))
+            return -1;
+        memcpy(dstBuffer, srcStart, srcBuffer - srcStart - 1);
+        dstBuffer += srcBuffer - srcStart - 1;
+        dstBufferSize -= srcBuffer - srcStart;
+        *dstBuffer++ = *srcBuffer++;
+        srcStart = srcBuffer;
     }
     memcpy(dstBuffer, srcStart, srcEnd - srcStart);
     dstBuffer += srcEnd - srcStart;
@@ -168,23 +131,17 @@ int NALUnit::decodeNAL2(const uint8_t* srcBuffer, const uint8_t* srcEnd, uint8_t
     const uint8_t* initDstBuffer = dstBuffer;
     const uint8_t* srcStart = srcBuffer;
     *keepSrcBuffer = true;
-    for (srcBuffer += 3; srcBuffer < srcEnd;)
+    for (srcBuffer = findUnescapePos(srcBuffer + 3, srcEnd); srcBuffer < srcEnd;
+         srcBuffer = findUnescapePos(srcBuffer, srcEnd))
     {
-        if (*srcBuffer > 3)
-            srcBuffer += 4;
-        else if (srcBuffer[-3] == 0 && srcBuffer[-2] == 0 && srcBuffer[-1] == 3)
-        {
-            if (dstBufferSize < static_cast<size_t>(srcBuffer - srcStart))
-                return -1;
-            memcpy(dstBuffer, srcStart, srcBuffer - srcStart - 1);
-            dstBuffer += srcBuffer - srcStart - 1;
-            dstBufferSize -= srcBuffer - srcStart;
-            *dstBuffer++ = *srcBuffer++;
-            srcStart = srcBuffer;
-            *keepSrcBuffer = false;
-        }
-        else
-            srcBuffer++;
+        if (dstBufferSize < static_cast<size_t>(srcBuffer - srcStart))
+            return -1;
+        memcpy(dstBuffer, srcStart, srcBuffer - srcStart - 1);
+        dstBuffer += srcBuffer - srcStart - 1;
+        dstBufferSize -= srcBuffer - srcStart;
+        *dstBuffer++ = *srcBuffer++;
+        srcStart = srcBuffer;
+        *keepSrcBuffer = false;
     }
     if (!*keepSrcBuffer)
         memcpy(dstBuffer, srcStart, srcEnd - srcStart);
@@ -192,6 +149,16 @@ int NALUnit::decodeNAL2(const uint8_t* srcBuffer, const uint8_t* srcEnd, uint8_t
     return static_cast<int>(dstBuffer - initDstBuffer);
 }
 
+bool NALUnit::needEncoding(const uint8_t* buffer, const uint8_t* end)
+{
+    return end - buffer > 2 && findEscapePos(buffer + 2, end) != end;
+}
+
+bool NALUnit::needDecoding(const uint8_t* buffer, const uint8_t* end)
+{
+    return end - buffer > 3 && findUnescapePos(buffer + 3, end) != end;
+}
+
 unsigned NALUnit::extractUEGolombCode(uint8_t* buffer, const uint8_t* bufEnd)
 {
     BitStreamReader reader{};
@@ -199,15 +166,7 @@ unsigned NALUnit::extractUEGolombCode(uint8_t* buffer, const uint8_t* bufEnd)
     return extractUEGolombCode(reader);
 }
 
-unsigned NALUnit::extractUEGolombCode()
-{
-    unsigned cnt = 0;
-    for (; bitReader.getBit() == 0; cnt++)
-        ;
-    if (cnt > INT_BIT)
-        THROW_BITSTREAM_ERR;
-    return (1 << cnt) - 1 + bitReader.getBits(cnt);
-}
+unsigned NALUnit::extractUEGolombCode() { return bitReader.getUEGolombCode(); }
 
 void NALUnit::writeSEGolombCode(BitStreamWriter& bitWriter, const int32_t value)
 {
@@ -232,21 +191,9 @@ void NALUnit::writeUEGolombCode(BitStreamWriter& bitWriter, const uint32_t value
     bitWriter.putBits(nBit, value - (x - 1));
 }
 
-unsigned NALUnit::extractUEGolombCode(BitStreamReader& bitReader)
-{
-    int cnt = 0;
-    for (; bitReader.getBit() == 0; cnt++)
-        ;
-    return (1 << cnt) - 1 + bitReader.getBits(cnt);
-}
+unsigned NALUnit::extractUEGolombCode(BitStreamReader& bitReader) { return bitReader.getUEGolombCode(); }
 
-int NALUnit::extractSEGolombCode()
-{
-    const unsigned rez = extractUEGolombCode();
-    if (rez % 2 == 0)
-        return -static_cast<int>(rez / 2);
-    return static_cast<int>((rez + 1) / 2);
-}
+int NALUnit::extractSEGolombCode() { return bitReader.getSEGolombCode(); }
 
 int NALUnit::deserialize(uint8_t* buffer, uint8_t* end)
 {
@@ -78,6 +78,9 @@ class NALUnit
     static int decodeNAL(const uint8_t* srcBuffer, const uint8_t* srcEnd, uint8_t* dstBuffer, size_t dstBufferSize);
     static int decodeNAL2(const uint8_t* srcBuffer, const uint8_t* srcEnd, uint8_t* dstBuffer, size_t dstBufferSize,
                           bool* keepSrcBuffer);  // do not copy buffer if nothink to decode
+    // fast checks: false if encodeNAL / decodeNAL would return an exact copy of the buffer
+    static bool needEncoding(const uint8_t* buffer, const uint8_t* end);
+    static bool needDecoding(const uint8_t* buffer, const uint8_t* end);
     virtual int deserialize(uint8_t* buffer, uint8_t* end);
     virtual int serializeBuffer(uint8_t* dstBuffer, uint8_t* dstEnd, bool writeStartCode) const;
     virtual int serialize(uint8_t* dstBuffer);
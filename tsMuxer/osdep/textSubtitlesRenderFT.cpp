@@ -14,6 +14,7 @@
 
 #include <algorithm>
 #include <map>
+#include <mutex>
 
 #if defined(_WIN32)
 static constexpr char FONT_ROOT[] = "c:/WINDOWS/Fonts";  // for debug only
@@ -43,6 +44,7 @@ namespace text_subtitles
 {
 FT_Library TextSubtitlesRenderFT::library;
 std::map<std::string, std::string> TextSubtitlesRenderFT::m_fontNameToFile;
+std::mutex TextSubtitlesRenderFT::m_libraryMtx;
 
 constexpr double PI = 3.1415926f;
 constexpr double angle = -PI / 10.0f;
@@ -58,15 +60,14 @@ uint32_t convertColor(uint32_t color)
 
 TextSubtitlesRenderFT::TextSubtitlesRenderFT() : TextSubtitlesRender()
 {
-    static bool initialized = false;
-    if (!initialized)
-    {
+    // the jobs of a batch may render subtitles concurrently
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
         int error = FT_Init_FreeType(&library);
         if (error)
             THROW(ERR_COMMON, "Can't initialize freeType font library");
         loadFontMap();
-        initialized = true;
-    }
+    });
     m_pData = nullptr;
     italic_matrix.xx = static_cast<FT_Fixed>(cos(angle) * 0x10000L);
     italic_matrix.xy = static_cast<FT_Fixed>(-sin(angle) * 0x10000L);
@@ -202,6 +203,7 @@ int TextSubtitlesRenderFT::loadFont(const string& fontName, FT_Face& face)
     const auto itr = m_fontMap.find(fontName);
     if (itr == m_fontMap.end())
     {
+        std::lock_guard lock(m_libraryMtx);
         const int error = FT_New_Face(library, fontName.c_str(), 0, &face);
         if (error)
             return error;
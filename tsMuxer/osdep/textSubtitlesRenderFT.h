@@ -4,6 +4,7 @@
 #include <ft2build.h>
 
 #include <map>
+#include <mutex>
 
 #include "../textSubtitlesRender.h"
 
@@ -28,6 +29,7 @@ class TextSubtitlesRenderFT final : public TextSubtitlesRender
    private:
     static FT_Library library;
     static std::map<std::string, std::string> m_fontNameToFile;
+    static std::mutex m_libraryMtx;  // faces are created by the renderers of concurrent threads
     FT_Face m_face;
     bool m_emulateItalic;
     bool m_emulateBold;
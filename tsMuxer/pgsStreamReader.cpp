@@ -740,7 +740,7 @@ CheckStreamRez PGSStreamReader::checkStream(uint8_t* buffer, int len, ContainerT
         rez.streamDescr = "Presentation Graphic Stream";
         if (containerStreamIndex >= 0x1200)
             rez.streamDescr +=
-                std::string(" #") + int32ToStr(containerStreamIndex - (V3_flags & 0x1e ? 0x12A0 : 0x1200));
+                std::string(" #") + int32ToStr(containerStreamIndex - (m_v3Info->flags() & 0x1e ? 0x12A0 : 0x1200));
     }
     else if (containerType == ContainerType::ctMKV && containerDataType == TRACKTYPE_PGS)
     {
@@ -12,7 +12,7 @@ class ProgramStreamDemuxer final : public AbstractDemuxer
    public:
     static constexpr int MAX_PES_HEADER_SIZE = 1018;  // buffer for PES header and program stream map
 
-    ProgramStreamDemuxer(const BufferedReaderManager& readManager);
+    ProgramStreamDemuxer(BufferedReaderManager& readManager, const char* streamName = "");
     void openFile(const std::string& streamName) override;
     static int readPacket(AVPacket& avPacket) { return 0; }
     ~ProgramStreamDemuxer() override;
@@ -40,7 +40,7 @@ class ProgramStreamDemuxer final : public AbstractDemuxer
     uint8_t m_tmpBuffer[MAX_PES_HEADER_SIZE];  // TS_FRAME_SIZE
     uint32_t m_lastPesLen;
     int32_t m_lastPID;
-    const BufferedReaderManager& m_readManager;
+    BufferedReaderManager& m_readManager;
     int64_t m_dataProcessed;
     std::string m_streamName;
     int m_readerID;
@@ -26,6 +26,21 @@ std::string getNewName(const std::string& oldName, const int cnt)
     return oldName + ".wav" + int32ToStr(cnt);
 }
 
+SingleFileMuxer::StreamInfo::StreamInfo(OutputBlockPool* pool) : m_pool(pool)
+{
+    // reserve extra ADD_DATA_SIZE bytes for stream additional data
+    assert(static_cast<size_t>(DEFAULT_FILE_BLOCK_SIZE) + MAX_AV_PACKET_SIZE + ADD_DATA_SIZE <= m_pool->blockSize());
+    m_buffer = m_pool->acquire();
+    m_bufLen = 0;
+    m_dts = -1;
+    m_pts = -1;
+    m_codecReader = nullptr;
+    m_totalWrited = 0;
+    m_part = 1;
+}
+
+SingleFileMuxer::StreamInfo::~StreamInfo() { m_pool->release(m_buffer); }
+
 SingleFileMuxer::SingleFileMuxer(MuxerManager* owner) : AbstractMuxer(owner), m_lastIndex(-1) {}
 
 SingleFileMuxer::~SingleFileMuxer()
@@ -152,7 +167,7 @@ void SingleFileMuxer::intAddStream(const std::string& streamName, const std::str
         fileName += itr->second;
     }
 
-    auto streamInfo = new StreamInfo(static_cast<unsigned>(DEFAULT_FILE_BLOCK_SIZE));
+    auto streamInfo = new StreamInfo(m_owner->getOutputBlockPool());
     streamInfo->m_fileName = fileName + fileExt;
     if (streamInfo->m_fileName.size() > 254)
         LTRACE(LT_ERROR, 2, "Error: File name too long.");
@@ -186,9 +201,9 @@ void SingleFileMuxer::writeOutBuffer(StreamInfo* streamInfo)
         constexpr int toFileLen = blockSize & 0xffff0000;
         if (m_owner->isAsyncMode())
         {
-            const auto newBuf = new uint8_t[blockSize + MAX_AV_PACKET_SIZE];
+            const auto newBuf = streamInfo->m_pool->acquire();
             memcpy(newBuf, streamInfo->m_buffer + toFileLen, streamInfo->m_bufLen - toFileLen);
-            m_owner->asyncWriteBuffer(this, streamInfo->m_buffer, toFileLen, &streamInfo->m_file);
+            m_owner->asyncWriteBuffer(this, streamInfo->m_buffer, toFileLen, &streamInfo->m_file, streamInfo->m_pool);
             streamInfo->m_buffer = newBuf;
         }
         else
@@ -265,14 +280,16 @@ bool SingleFileMuxer::doFlush()
         {
             if (lastBlockSize > 0)
             {
-                const auto newBuff = new uint8_t[lastBlockSize];
+                const auto newBuff = streamInfo->m_pool->acquire();
                 memcpy(newBuff, streamInfo->m_buffer + roundBufLen, lastBlockSize);
-                m_owner->asyncWriteBuffer(this, streamInfo->m_buffer, roundBufLen, &streamInfo->m_file);
+                m_owner->asyncWriteBuffer(this, streamInfo->m_buffer, roundBufLen, &streamInfo->m_file,
+                                          streamInfo->m_pool);
                 streamInfo->m_buffer = newBuff;
             }
             else
             {
-                m_owner->asyncWriteBuffer(this, streamInfo->m_buffer, roundBufLen, &streamInfo->m_file);
+                m_owner->asyncWriteBuffer(this, streamInfo->m_buffer, roundBufLen, &streamInfo->m_file,
+                                          streamInfo->m_pool);
                 streamInfo->m_buffer = nullptr;
             }
         }
@@ -6,6 +6,8 @@
 #include "abstractMuxer.h"
 #include "avPacket.h"
 
+class OutputBlockPool;
+
 class SingleFileMuxer final : public AbstractMuxer
 {
    public:
@@ -29,23 +31,14 @@ class SingleFileMuxer final : public AbstractMuxer
         std::string m_fileName;
         int64_t m_dts;
         int64_t m_pts;
-        uint8_t* m_buffer;
+        uint8_t* m_buffer;  // block of m_pool
         int m_part;
         int m_bufLen;
         uint64_t m_totalWrited;
         AbstractStreamReader* m_codecReader;
-        StreamInfo(const int blockSize)
-        {
-            m_buffer = new uint8_t[blockSize + MAX_AV_PACKET_SIZE +
-                                   ADD_DATA_SIZE];  // reserv extra ADD_DATA_SIZE bytes for stream additional data
-            m_bufLen = 0;
-            m_dts = -1;
-            m_pts = -1;
-            m_codecReader = nullptr;
-            m_totalWrited = 0;
-            m_part = 1;
-        }
-        ~StreamInfo() { delete[] m_buffer; }
+        OutputBlockPool* m_pool;
+        StreamInfo(OutputBlockPool* pool);
+        ~StreamInfo();
     };
     int m_lastIndex;
     std::map<std::string, int> m_trackNameTmp;
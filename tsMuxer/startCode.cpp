@@ -0,0 +1,323 @@
+#include "startCode.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define START_CODE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__)
+#define START_CODE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(START_CODE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+enum class Pattern
+{
+    StartCode,  // 00 00 01
+    Escape,     // 00 00 0x, x <= 3
+    Unescape    // 00 00 03 0x, x <= 3
+};
+
+// ---------------------------- scalar search ------------------------------
+
+// The searches return the position of the last byte of the pattern. Bytes which can't be part of the pattern allow to
+// skip the positions they would have to precede.
+template <Pattern P>
+const uint8_t* findScalar(const uint8_t* pos, const uint8_t* end);
+
+template <>
+const uint8_t* findScalar<Pattern::StartCode>(const uint8_t* pos, const uint8_t* end)
+{
+    while (pos < end)
+    {
+        if (*pos > 1)
+            pos += 3;
+        else if (*pos == 0)
+            pos++;
+        else  // *pos == 1
+        {
+            if (pos[-2] == 0 && pos[-1] == 0)
+                return pos;
+            pos += 3;
+        }
+    }
+    return end;
+}
+
+template <>
+const uint8_t* findScalar<Pattern::Escape>(const uint8_t* pos, const uint8_t* end)
+{
+    while (pos < end)
+    {
+        if (*pos > 3)
+            pos += 3;
+        else if (pos[-2] == 0 && pos[-1] == 0)
+            return pos;
+        else
+            pos++;
+    }
+    return end;
+}
+
+template <>
+const uint8_t* findScalar<Pattern::Unescape>(const uint8_t* pos, const uint8_t* end)
+{
+    while (pos < end)
+    {
+        if (*pos > 3)
+            pos += 4;
+        else if (pos[-3] == 0 && pos[-2] == 0 && pos[-1] == 3)
+            return pos;
+        else
+            pos++;
+    }
+    return end;
+}
+
+// ---------------------------- vector search ------------------------------
+
+// Bit i of each mask describes the byte pos + i of a 64 bytes block.
+struct ByteMasks
+{
+    uint64_t zero;
+    uint64_t one;
+    uint64_t three;
+    uint64_t upTo3;
+};
+
+int lowestBit(const uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// mask of the bytes `shift` positions before the bytes of the current block, prev is the mask of the previous block
+inline uint64_t before(const uint64_t cur, const uint64_t prev, const int shift)
+{
+    return cur << shift | prev >> (64 - shift);
+}
+
+template <Pattern P>
+inline uint64_t matches(const ByteMasks& cur, const ByteMasks& prev)
+{
+    const uint64_t zeroZero = before(cur.zero, prev.zero, 1) & before(cur.zero, prev.zero, 2);
+    if constexpr (P == Pattern::StartCode)
+        return cur.one & zeroZero;
+    else if constexpr (P == Pattern::Escape)
+        return cur.upTo3 & zeroZero;
+    else
+    {
+        // only the last bit of the previous block is shifted in
+        const uint64_t prevZeroZero = prev.zero << 1 & prev.zero << 2;
+        return cur.upTo3 & before(cur.three, prev.three, 1) & before(zeroZero, prevZeroZero, 1);
+    }
+}
+
+// The masks of the bytes in front of pos, as if they ended a previous block.
+template <Pattern P>
+ByteMasks prevMasks(const uint8_t* pos)
+{
+    ByteMasks masks{};
+    for (int i = 1; i <= (P == Pattern::Unescape ? 3 : 2); i++)
+    {
+        masks.zero |= static_cast<uint64_t>(pos[-i] == 0) << (64 - i);
+        masks.three |= static_cast<uint64_t>(pos[-i] == 3) << (64 - i);
+    }
+    return masks;
+}
+
+#ifdef START_CODE_X86
+
+ByteMasks loadMasksSSE2(const uint8_t* pos)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i three = _mm_set1_epi8(3);
+    ByteMasks masks{};
+    for (int i = 0; i < 4; i++)
+    {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos + i * 16));
+        const __m128i upTo3 = _mm_cmpeq_epi8(_mm_min_epu8(data, three), data);
+        masks.zero |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, zero))) << (i * 16);
+        masks.one |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, one))) << (i * 16);
+        masks.three |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, three))) << (i * 16);
+        masks.upTo3 |= static_cast<uint64_t>(_mm_movemask_epi8(upTo3)) << (i * 16);
+    }
+    return masks;
+}
+
+template <Pattern P>
+const uint8_t* findSSE2(const uint8_t* pos, const uint8_t* end)
+{
+    ByteMasks prev = prevMasks<P>(pos);
+    for (; end - pos >= 64; pos += 64)
+    {
+        const ByteMasks cur = loadMasksSSE2(pos);
+        const uint64_t found = matches<P>(cur, prev);
+        if (found)
+            return pos + lowestBit(found);
+        prev = cur;
+    }
+    return findScalar<P>(pos, end);
+}
+
+TARGET_AVX2 uint64_t byteMask(const __m256i lo, const __m256i hi)
+{
+    return static_cast<uint32_t>(_mm256_movemask_epi8(lo)) |
+           static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hi))) << 32;
+}
+
+TARGET_AVX2 ByteMasks loadMasksAVX2(const uint8_t* pos)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i three = _mm256_set1_epi8(3);
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos + 32));
+    ByteMasks masks;
+    masks.zero = byteMask(_mm256_cmpeq_epi8(lo, zero), _mm256_cmpeq_epi8(hi, zero));
+    masks.one = byteMask(_mm256_cmpeq_epi8(lo, one), _mm256_cmpeq_epi8(hi, one));
+    masks.three = byteMask(_mm256_cmpeq_epi8(lo, three), _mm256_cmpeq_epi8(hi, three));
+    masks.upTo3 = byteMask(_mm256_cmpeq_epi8(_mm256_min_epu8(lo, three), lo),
+                           _mm256_cmpeq_epi8(_mm256_min_epu8(hi, three), hi));
+    return masks;
+}
+
+template <Pattern P>
+TARGET_AVX2 const uint8_t* findAVX2(const uint8_t* pos, const uint8_t* end)
+{
+    ByteMasks prev = prevMasks<P>(pos);
+    for (; end - pos >= 64; pos += 64)
+    {
+        const ByteMasks cur = loadMasksAVX2(pos);
+        const uint64_t found = matches<P>(cur, prev);
+        if (found)
+            return pos + lowestBit(found);
+        prev = cur;
+    }
+    return findScalar<P>(pos, end);
+}
+
+bool cpuHasAVX2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return false;
+    __cpuid(regs, 1);
+    // the OS must save the AVX registers
+    constexpr int OSXSAVE_AVX = (1 << 27) | (1 << 28);
+    if ((regs[2] & OSXSAVE_AVX) != OSXSAVE_AVX || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+#endif  // START_CODE_X86
+
+#ifdef START_CODE_NEON
+
+uint64_t byteMask(const uint8x16_t m0, const uint8x16_t m1, const uint8x16_t m2, const uint8x16_t m3)
+{
+    // NEON has no movemask: each byte keeps its own bit, then the bytes are summed pairwise down to 8 bytes
+    const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t sum01 = vpaddq_u8(vandq_u8(m0, bits), vandq_u8(m1, bits));
+    const uint8x16_t sum23 = vpaddq_u8(vandq_u8(m2, bits), vandq_u8(m3, bits));
+    uint8x16_t sum = vpaddq_u8(sum01, sum23);
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+
+ByteMasks loadMasksNEON(const uint8_t* pos)
+{
+    const uint8x16x4_t data = vld1q_u8_x4(pos);
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint8x16_t three = vdupq_n_u8(3);
+    ByteMasks masks;
+    masks.zero = byteMask(vceqzq_u8(data.val[0]), vceqzq_u8(data.val[1]), vceqzq_u8(data.val[2]),
+                          vceqzq_u8(data.val[3]));
+    masks.one = byteMask(vceqq_u8(data.val[0], one), vceqq_u8(data.val[1], one), vceqq_u8(data.val[2], one),
+                         vceqq_u8(data.val[3], one));
+    masks.three = byteMask(vceqq_u8(data.val[0], three), vceqq_u8(data.val[1], three), vceqq_u8(data.val[2], three),
+                           vceqq_u8(data.val[3], three));
+    masks.upTo3 = byteMask(vcleq_u8(data.val[0], three), vcleq_u8(data.val[1], three), vcleq_u8(data.val[2], three),
+                           vcleq_u8(data.val[3], three));
+    return masks;
+}
+
+template <Pattern P>
+const uint8_t* findNEON(const uint8_t* pos, const uint8_t* end)
+{
+    ByteMasks prev = prevMasks<P>(pos);
+    for (; end - pos >= 64; pos += 64)
+    {
+        const ByteMasks cur = loadMasksNEON(pos);
+        const uint64_t found = matches<P>(cur, prev);
+        if (found)
+            return pos + lowestBit(found);
+        prev = cur;
+    }
+    return findScalar<P>(pos, end);
+}
+
+#endif  // START_CODE_NEON
+
+typedef const uint8_t* (*FindFunc)(const uint8_t* pos, const uint8_t* end);
+
+template <Pattern P>
+FindFunc selectFind()
+{
+#if defined(START_CODE_X86)
+    return cpuHasAVX2() ? findAVX2<P> : findSSE2<P>;
+#elif defined(START_CODE_NEON)
+    return findNEON<P>;
+#else
+    return findScalar<P>;
+#endif
+}
+
+template <Pattern P>
+const uint8_t* find(const uint8_t* pos, const uint8_t* end)
+{
+    static const FindFunc findImpl = selectFind<P>();
+    return findImpl(pos, end);
+}
+}  // namespace
+
+uint8_t* findStartCode(uint8_t* buffer, uint8_t* end)
+{
+    if (end - buffer < 3)
+        return end;
+    const uint8_t* pos = find<Pattern::StartCode>(buffer + 2, end);
+    return pos == end ? end : buffer + (pos - buffer) - 2;
+}
+
+const uint8_t* findEscapePos(const uint8_t* pos, const uint8_t* end)
+{
+    return pos < end ? find<Pattern::Escape>(pos, end) : end;
+}
+
+const uint8_t* findUnescapePos(const uint8_t* pos, const uint8_t* end)
+{
+    return pos < end ? find<Pattern::Unescape>(pos, end) : end;
+}
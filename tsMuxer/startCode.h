@@ -0,0 +1,20 @@
+#ifndef START_CODE_H_
+#define START_CODE_H_
+
+#include <cstdint>
+
+// Byte pattern searches of the NAL and MPEG parsers. They use the widest vector instructions supported by the CPU, the
+// implementation is selected on first use.
+
+// Returns the first 00 00 01 start code (or MPEG/VC-1 marker prefix) found in [buffer, end), or end if there is none.
+uint8_t* findStartCode(uint8_t* buffer, uint8_t* end);
+
+// Returns the first byte in [pos, end) which follows 00 00 and is not greater than 3, i.e. the first byte which needs
+// an emulation prevention byte in front of it. Returns end if there is none. pos[-2] and pos[-1] must be readable.
+const uint8_t* findEscapePos(const uint8_t* pos, const uint8_t* end);
+
+// Returns the first byte in [pos, end) which follows an emulation prevention sequence 00 00 03 and is not greater than
+// 3, or end if there is none. pos[-3] to pos[-1] must be readable.
+const uint8_t* findUnescapePos(const uint8_t* pos, const uint8_t* end);
+
+#endif  // START_CODE_H_
@@ -14,7 +14,7 @@ bool isM2TSExt(const std::string& streamName)
     return strEndWith(sName, ".m2ts") || strEndWith(sName, ".mts") || strEndWith(sName, ".ssif");
 }
 
-TSDemuxer::TSDemuxer(const BufferedReaderManager& readManager, const char* streamName)
+TSDemuxer::TSDemuxer(BufferedReaderManager& readManager, const char* streamName)
     : m_readManager(readManager),
       m_curPos(nullptr),
       m_pmtPid(0),
@@ -138,7 +138,7 @@ void TSDemuxer::getTrackList(std::map<int32_t, TrackInfo>& trackList)
                         nonProcPMTPid.erase(pid);
                         if (nonProcPMTPid.empty() && !mvcContinueExpected())
                         {  // all pmt pids processed
-                            auto br = dynamic_cast<BufferedFileReader*>(m_bufferedReader);
+                            auto br = dynamic_cast<BufferedReader*>(m_bufferedReader);
                             if (br)
                                 br->incSeek(m_readerID, -static_cast<int64_t>(totalReadedBytes));
                             else
@@ -156,7 +156,7 @@ void TSDemuxer::getTrackList(std::map<int32_t, TrackInfo>& trackList)
         }
     }
 
-    auto br = dynamic_cast<BufferedFileReader*>(m_bufferedReader);
+    auto br = dynamic_cast<BufferedReader*>(m_bufferedReader);
     if (br)
         br->incSeek(m_readerID, -static_cast<int64_t>(totalReadedBytes));
     else
@@ -340,111 +340,134 @@ int TSDemuxer::simpleDemuxBlock(DemuxedData& demuxedData, const PIDSet& accepted
         }
         m_m2tsHdrDiscarded = false;
 
-        const auto tsPacket = reinterpret_cast<TSPacket*>(m_curPos);
-        int pid = tsPacket->getPID();
-        discardSize += TS_FRAME_SIZE;
-
-        // pcrFrames++;
-
-        if (tsPacket->afExists)
+        // the packets in sync with this one are handled as a run, the resync above is needed only once per run
+        const size_t packetCnt = classifyPackets(m_curPos, lastFrameAddr);
+        for (size_t i = 0; i < packetCnt; i++)
         {
-            if (tsPacket->adaptiveField.pcrExist)
-            {
-                // if (prevPCR == -1)
-                //	prevPCR = tsPacket->adaptiveField.getPCR33();
-
-                // prevPCR = tsPacket->adaptiveField.getPCR33();
-                // LTRACE(LT_INFO, 2, "pcr: " << prevPCR - 55729419ll);
-                // pcrFrames = 0;
-            }
+            const PacketInfo& packet = m_packets[i];
+            if (i > 0 && m_m2tsMode)
+                discardSize += 4;
+            discardSize += TS_FRAME_SIZE;
+            m_curPos = packet.pos;
+            // only the PES headers of the other PIDs are looked at, for their timestamps
+            if (!packet.payloadStart && !m_acceptedPidCache[packet.pid])
+                continue;
+            demuxPacket(demuxedData, packet.pid, vect, lastPid, discardSize);
         }
+    }
+    if (m_curPos < data + readedBytes)
+    {
+        m_tmpBufferLen = data + readedBytes - m_curPos;
+        memmove(m_tmpBuffer, m_curPos, m_tmpBufferLen);
+    }
 
-        uint8_t* frameData = m_curPos + tsPacket->getHeaderSize();
-        const bool pesStartCode = frameData[0] == 0 && frameData[1] == 0 && frameData[2] == 1 && tsPacket->payloadStart;
-        if (pesStartCode)
-        {
-            const auto pesPacket = reinterpret_cast<PESPacket*>(frameData);
-            auto streamInfo = m_pmt.pidList.find(pid);
+    return 0;
+}
 
-            if ((pesPacket->flagsLo & 0x80) == 0x80)
-            {
-                const int64_t curPts = pesPacket->getPts();
-                int64_t curDts = curPts;
+size_t TSDemuxer::classifyPackets(uint8_t* pos, const uint8_t* lastFrameAddr)
+{
+    const int64_t stride = TS_FRAME_SIZE + (m_m2tsMode ? 4 : 0);
+    const auto maxCnt = static_cast<size_t>((lastFrameAddr - pos) / stride + 1);
+    if (m_packets.size() < maxCnt)
+        m_packets.resize(maxCnt);
+
+    // the first packet is known to be in sync
+    size_t cnt = 0;
+    do
+    {
+        PacketInfo& packet = m_packets[cnt++];
+        packet.pos = pos;
+        packet.pid = (pos[1] & 0x1f) << 8 | pos[2];
+        packet.payloadStart = (pos[1] & 0x40) != 0;
+        pos += stride;
+    } while (pos <= lastFrameAddr && *pos == TSPacket::TS_FRAME_SYNC_BYTE);
+    return cnt;
+}
 
-                if ((pesPacket->flagsLo & 0xc0) == 0xc0)
-                    curDts = pesPacket->getDts();
+void TSDemuxer::demuxPacket(DemuxedData& demuxedData, const int pid, MemoryBlock*& vect, int& lastPid,
+                            int64_t& discardSize)
+{
+    const auto tsPacket = reinterpret_cast<TSPacket*>(m_curPos);
 
-                if (m_lastPTS == -1 || curPts > m_lastPTS)
-                    m_lastPTS = curPts;
+    uint8_t* frameData = m_curPos + tsPacket->getHeaderSize();
+    const bool pesStartCode = frameData[0] == 0 && frameData[1] == 0 && frameData[2] == 1 && tsPacket->payloadStart;
+    if (pesStartCode)
+    {
+        const auto pesPacket = reinterpret_cast<PESPacket*>(frameData);
+        auto streamInfo = m_pmt.pidList.find(pid);
 
-                if (m_firstPTS == -1 || curPts < m_firstPTS)
-                    m_firstPTS = curPts;
+        if ((pesPacket->flagsLo & 0x80) == 0x80)
+        {
+            const int64_t curPts = pesPacket->getPts();
+            int64_t curDts = curPts;
 
-                if (streamInfo != m_pmt.pidList.end() && isVideoPID(streamInfo->second.m_streamType))
-                {
-                    if (m_firstVideoPTS == -1 || curPts < m_firstVideoPTS)
-                        m_firstVideoPTS = curPts;
-                    if (curPts > m_lastVideoPTS)
-                        m_lastVideoPTS = curPts;
-                    if (m_lastVideoDTS == -1)
-                        m_lastVideoDTS = curDts;
-                    if (m_videoDtsGap == -1 && curDts > m_lastVideoDTS)
-                        m_videoDtsGap = curDts - m_lastVideoDTS;
-                }
+            if ((pesPacket->flagsLo & 0xc0) == 0xc0)
+                curDts = pesPacket->getDts();
 
-                if (m_firstPtsTime.find(pid) == m_firstPtsTime.end() ||
-                    (m_curFileNum == 0 && curPts < m_firstPtsTime[pid]))
-                    m_firstPtsTime[pid] = curPts;
-            }
+            if (m_lastPTS == -1 || curPts > m_lastPTS)
+                m_lastPTS = curPts;
+
+            if (m_firstPTS == -1 || curPts < m_firstPTS)
+                m_firstPTS = curPts;
 
-            if (streamInfo != m_pmt.pidList.end() &&
-                streamInfo->second.m_streamType != StreamType::SUB_PGS)  // demux PGS with PES headers
-                frameData += pesPacket->getHeaderLength();
-            else
+            if (streamInfo != m_pmt.pidList.end() && isVideoPID(streamInfo->second.m_streamType))
             {
-                const int64_t ptsBase = m_firstVideoPTS != -1 ? m_firstVideoPTS : m_firstPTS;
-                if ((pesPacket->flagsLo & 0xc0) == 0xc0)
-                {
-                    const int64_t pts = pesPacket->getPts() - ptsBase + m_prevFileLen;
-                    const int64_t dts = pesPacket->getDts() - ptsBase + m_prevFileLen;
-                    pesPacket->setPtsAndDts(pts, dts);
-                }
-                else if ((pesPacket->flagsLo & 0x80) == 0x80)
-                {
-                    const int64_t pts = pesPacket->getPts() - ptsBase + m_prevFileLen;
-                    pesPacket->setPts(pts);
-                }
+                if (m_firstVideoPTS == -1 || curPts < m_firstVideoPTS)
+                    m_firstVideoPTS = curPts;
+                if (curPts > m_lastVideoPTS)
+                    m_lastVideoPTS = curPts;
+                if (m_lastVideoDTS == -1)
+                    m_lastVideoDTS = curDts;
+                if (m_videoDtsGap == -1 && curDts > m_lastVideoDTS)
+                    m_videoDtsGap = curDts - m_lastVideoDTS;
             }
-        }
 
-        // if (acceptedPIDs.find(pid) == acceptedPIDs.end())
-        if (!m_acceptedPidCache[pid])
-            continue;
+            const bool firstPes = !m_firstPtsTime.contains(pid);
+            int64_t& firstPts = m_firstPtsTime[pid];
+            if (firstPes || (m_curFileNum == 0 && curPts < firstPts))
+                firstPts = curPts;
+        }
 
-        const int64_t payloadLen = TS_FRAME_SIZE - (frameData - m_curPos);
-        if (payloadLen > 0)
+        if (streamInfo != m_pmt.pidList.end() &&
+            streamInfo->second.m_streamType != StreamType::SUB_PGS)  // demux PGS with PES headers
+            frameData += pesPacket->getHeaderLength();
+        else
         {
-            if (pid != lastPid)
+            const int64_t ptsBase = m_firstVideoPTS != -1 ? m_firstVideoPTS : m_firstPTS;
+            if ((pesPacket->flagsLo & 0xc0) == 0xc0)
             {
-                vect = &demuxedData[pid];
-                lastPid = pid;
+                const int64_t pts = pesPacket->getPts() - ptsBase + m_prevFileLen;
+                const int64_t dts = pesPacket->getDts() - ptsBase + m_prevFileLen;
+                pesPacket->setPtsAndDts(pts, dts);
             }
-            if (vect != nullptr)
+            else if ((pesPacket->flagsLo & 0x80) == 0x80)
             {
-                vect->grow(payloadLen);
-                uint8_t* dst = vect->data() + vect->size() - payloadLen;
-                memcpy(dst, frameData, payloadLen);
+                const int64_t pts = pesPacket->getPts() - ptsBase + m_prevFileLen;
+                pesPacket->setPts(pts);
             }
         }
-        discardSize -= payloadLen;
     }
-    if (m_curPos < data + readedBytes)
+
+    // if (acceptedPIDs.find(pid) == acceptedPIDs.end())
+    if (!m_acceptedPidCache[pid])
+        return;
+
+    const int64_t payloadLen = TS_FRAME_SIZE - (frameData - m_curPos);
+    if (payloadLen > 0)
     {
-        m_tmpBufferLen = data + readedBytes - m_curPos;
-        memmove(m_tmpBuffer, m_curPos, m_tmpBufferLen);
+        if (pid != lastPid)
+        {
+            vect = &demuxedData[pid];
+            lastPid = pid;
+        }
+        if (vect != nullptr)
+        {
+            vect->grow(payloadLen);
+            uint8_t* dst = vect->data() + vect->size() - payloadLen;
+            memcpy(dst, frameData, payloadLen);
+        }
     }
-
-    return 0;
+    discardSize -= payloadLen;
 }
 
 void TSDemuxer::openFile(const std::string& streamName)
@@ -452,12 +475,7 @@ void TSDemuxer::openFile(const std::string& streamName)
     m_streamName = streamName;
     m_streamNameLow = strToLowerCase(unquoteStr(streamName));
     readClose();
-    m_lastPesPts.clear();
-    m_lastPesDts.clear();
-    m_fullPtsTime.clear();
-    m_fullDtsTime.clear();
     m_firstPtsTime.clear();
-    m_firstDtsTime.clear();
     m_firstPCRTime = -1;
     m_lastPCRVal = -1;
 
@@ -481,7 +499,7 @@ int64_t TSDemuxer::getDemuxedSize() { return m_dataProcessed; }
 
 void TSDemuxer::setFileIterator(FileNameIterator* itr)
 {
-    const auto br = dynamic_cast<BufferedFileReader*>(m_bufferedReader);
+    const auto br = dynamic_cast<BufferedReader*>(m_bufferedReader);
     if (br)
         br->setFileIterator(itr, m_readerID);
     else if (itr != nullptr)
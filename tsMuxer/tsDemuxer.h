@@ -16,7 +16,7 @@
 class TSDemuxer final : public AbstractDemuxer
 {
    public:
-    TSDemuxer(const BufferedReaderManager& readManager, const char* streamName);
+    TSDemuxer(BufferedReaderManager& readManager, const char* streamName);
     ~TSDemuxer() override;
     void openFile(const std::string& streamName) override;
     void readClose() override;
@@ -27,9 +27,9 @@ class TSDemuxer final : public AbstractDemuxer
     void setFileIterator(FileNameIterator* itr) override;
     int64_t getTrackDelay(const int32_t pid) override
     {
-        if (m_firstPtsTime.find(pid) != m_firstPtsTime.end())
+        if (const int64_t* firstPts = m_firstPtsTime.find(pid))
         {
-            const int64_t clockTicks = m_firstPtsTime[pid] - (m_firstVideoPTS != -1 ? m_firstVideoPTS : m_firstPTS);
+            const int64_t clockTicks = *firstPts - (m_firstVideoPTS != -1 ? m_firstVideoPTS : m_firstPTS);
             return llround(static_cast<double>(clockTicks) / 90.0);  // convert to ms
         }
 
@@ -47,15 +47,10 @@ class TSDemuxer final : public AbstractDemuxer
     bool m_m2tsMode;
     int m_scale;
     int m_nptPos;
-    const BufferedReaderManager& m_readManager;
+    BufferedReaderManager& m_readManager;
     std::string m_streamName;
     std::string m_streamNameLow;
-    std::map<int, int64_t> m_lastPesPts;
-    std::map<int, int64_t> m_lastPesDts;
-    std::map<int, int64_t> m_firstPtsTime;
-    std::map<int, int64_t> m_firstDtsTime;
-    std::map<int, int64_t> m_fullPtsTime;
-    std::map<int, int64_t> m_fullDtsTime;
+    PIDTable<int64_t> m_firstPtsTime;
     AbstractReader* m_bufferedReader;
     int m_readerID;
     uint8_t* m_curPos;
@@ -85,8 +80,19 @@ class TSDemuxer final : public AbstractDemuxer
     uint8_t m_acceptedPidCache[8192];
     bool m_firstDemuxCall;
 
+    // header fields of a run of packets, extracted by a first pass over the block
+    struct PacketInfo
+    {
+        uint8_t* pos;
+        int pid;
+        bool payloadStart;
+    };
+    std::vector<PacketInfo> m_packets;
+
     static bool isVideoPID(StreamType streamType);
     bool checkForRealM2ts(const uint8_t* buffer, const uint8_t* end) const;
+    size_t classifyPackets(uint8_t* pos, const uint8_t* lastFrameAddr);
+    void demuxPacket(DemuxedData& demuxedData, int pid, MemoryBlock*& vect, int& lastPid, int64_t& discardSize);
 };
 
 #endif
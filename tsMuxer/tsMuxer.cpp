@@ -1,5 +1,6 @@
 #include "tsMuxer.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <fs/systemlog.h>
@@ -22,10 +23,29 @@
 
 using namespace std;
 
-int V3_flags = 0;
-unsigned HDR10_metadata[6] = {0, 0, 0, 0, 0, 0};
-bool isV3() { return V3_flags & HDMV_V3; }
-bool is4K() { return V3_flags & FOUR_K; }
+// ----------------------- V3Info ------------------------
+
+V3Info::V3Info() : m_flags(0), m_hevcPeakRate(false) { m_hdr10Metadata.fill(0); }
+
+void V3Info::setMasteringDisplay(const std::array<unsigned, 5>& metadata)
+{
+    std::lock_guard lock(m_metadataMtx);
+    std::copy(metadata.begin(), metadata.end(), m_hdr10Metadata.begin());
+}
+
+void V3Info::addContentLightLevel(const unsigned maxCLL, const unsigned maxFALL)
+{
+    std::lock_guard lock(m_metadataMtx);
+    const unsigned curCLL = (std::max)(maxCLL, m_hdr10Metadata[5] >> 16);
+    const unsigned curFALL = (std::max)(maxFALL, m_hdr10Metadata[5] & 0xffff);
+    m_hdr10Metadata[5] = (curCLL << 16) + curFALL;
+}
+
+std::array<unsigned, 6> V3Info::getHDR10Metadata() const
+{
+    std::lock_guard lock(m_metadataMtx);
+    return m_hdr10Metadata;
+}
 
 static constexpr int64_t M_PCR_DELTA = 7000;
 static constexpr int64_t SIT_INTERVAL = 76900;
@@ -37,7 +57,13 @@ static constexpr int PAT_PID = 0;
 static constexpr int SIT_PID = 0x1f;
 static constexpr int NULL_PID = 8191;
 
-uint8_t DefaultSitTableOne[] = {
+// num / den rounded half away from zero, as llround() does. den must be positive.
+static int64_t roundDiv(const int64_t num, const int64_t den)
+{
+    return num >= 0 ? (num + den / 2) / den : -((den / 2 - num) / den);
+}
+
+const uint8_t DefaultSitTableOne[] = {
     0x47, 0x40, 0x1f, 0x10, 0x00, 0x7f, 0xf0, 0x19, 0xff, 0xff, 0xc1, 0x00, 0x00, 0xf0, 0x0a, 0x63, 0x08, 0xc1, 0xd4,
     0xc0, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x01, 0x80, 0x00, 0x03, 0x00, 0x38, 0x6d, 0xff, 0xff, 0xff, 0xff, 0xff,
     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -50,8 +76,8 @@ uint8_t DefaultSitTableOne[] = {
     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 
 // for v3 Blu-ray, change "peak_rate" and CRC to 128 mbps
-uint8_t SitTableHEVC[] = {0xc4, 0xe1, 0x06, 0xff, 0xff, 0xff, 0xff, 0xff,
-                          0x00, 0x01, 0x80, 0x00, 0x24, 0xc4, 0xba, 0xf0};
+const uint8_t SitTableHEVC[] = {0xc4, 0xe1, 0x06, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                0x00, 0x01, 0x80, 0x00, 0x24, 0xc4, 0xba, 0xf0};
 
 TSMuxer::TSMuxer(MuxerManager* owner) : AbstractMuxer(owner)
 {
@@ -108,11 +134,13 @@ TSMuxer::TSMuxer(MuxerManager* owner) : AbstractMuxer(owner)
     m_muxFile = nullptr;
     m_isExternalFile = false;
     m_writeBlockSize = 0;
+    m_writeAlign = MuxerManager::PHYSICAL_SECTOR_SIZE;
     m_frameSize = 188;
 
     m_processedBlockSize = 0;
     m_sublingMuxer = nullptr;
     m_outBuf = nullptr;
+    m_blockPool = owner->getOutputBlockPool();
     m_masterMode = false;
     m_subMode = false;
     setPtsOffset(0);
@@ -135,7 +163,7 @@ void TSMuxer::internalReset() { m_outBufLen = 0; }
 
 TSMuxer::~TSMuxer()
 {
-    delete[] m_outBuf;
+    m_blockPool->release(m_outBuf);
     if (!m_isExternalFile)
         delete m_muxFile;
 }
@@ -182,7 +210,7 @@ void TSMuxer::intAddStream(const std::string& streamName, const std::string& cod
             {
                 tsStreamIndex = 0x1011 + m_videoTrackCnt * doubleMux;
                 m_videoTrackCnt++;
-                V3_flags |= BL_TRACK;
+                v3Info().addFlags(BL_TRACK);
             }
             if (m_subMode)
                 tsStreamIndex++;
@@ -208,9 +236,11 @@ void TSMuxer::intAddStream(const std::string& streamName, const std::string& cod
     }
     else if (codecName == "S_HDMV/PGS" || codecName == "S_TEXT/UTF8")
     {
-        tsStreamIndex = (V3_flags & 0x1e ? 0x12A0 : 0x1200) + m_pgsTrackCnt;
+        tsStreamIndex = (v3Info().flags() & 0x1e ? 0x12A0 : 0x1200) + m_pgsTrackCnt;
         m_pgsTrackCnt++;
     }
+    if (streamIndex >= static_cast<int>(m_extIndexToTSIndex.size()))
+        m_extIndexToTSIndex.resize(streamIndex + 1);
     m_extIndexToTSIndex[streamIndex] = tsStreamIndex;
 
     m_pmt.program_number = 1;
@@ -226,38 +256,38 @@ void TSMuxer::intAddStream(const std::string& streamName, const std::string& cod
     {
         if (codecName == "V_MS/VFW/WVC1")
         {
-            m_pesType[tsStreamIndex] = PES_VC1_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_VC1_ID;
         }
         else if (codecName == "V_MPEGH/ISO/HEVC")
         {
-            m_pesType[tsStreamIndex] = PES_HEVC_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_HEVC_ID;
         }
         else if (codecName == "V_MPEGI/ISO/VVC")
         {
-            m_pesType[tsStreamIndex] = PES_VVC_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_VVC_ID;
         }
         else
         {
-            m_pesType[tsStreamIndex] = PES_VIDEO_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_VIDEO_ID;
         }
     }
     else if (codecName[0] == 'A')
     {
         if (codecName == "A_AC3")
-            m_pesType[tsStreamIndex] = PES_INT_AC3_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_INT_AC3_ID;
         else if (codecName == "A_DTS")
-            m_pesType[tsStreamIndex] = PES_INT_DTS_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_INT_DTS_ID;
         else if (codecName == "A_MP3")
-            m_pesType[tsStreamIndex] = PES_AUDIO_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_AUDIO_ID;
         else
-            m_pesType[tsStreamIndex] = PES_PRIVATE_DATA1;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_PRIVATE_DATA1;
     }
     else if (codecName[0] == 'S')
     {
         if (codecName == "S_SUP" || codecName == "S_HDMV/PGS" || codecName == "S_TEXT/UTF8")
-            m_pesType[tsStreamIndex] = PES_PRIVATE_DATA1;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_PRIVATE_DATA1;
         else
-            m_pesType[tsStreamIndex] = PES_INT_SUB_ID;
+            m_streamInfo[tsStreamIndex].m_pesType = PES_INT_SUB_ID;
     }
 
     if (codecName[0] == 'V')
@@ -284,12 +314,12 @@ void TSMuxer::intAddStream(const std::string& streamName, const std::string& cod
     {
         StreamType stream_type = StreamType::VIDEO_H265;
         // Change "peak_rate" to 109 mbps + change descriptor CRC32
-        memcpy(&DefaultSitTableOne[17], SitTableHEVC, 16);
+        v3Info().setHevcPeakRate();
         // For non-bluray, second Dolby Vision track must be stream_type 06 = private data
-        if (!m_bluRayMode && tsStreamIndex == 0x1015 && (V3_flags & BL_TRACK))
+        if (!m_bluRayMode && tsStreamIndex == 0x1015 && (v3Info().flags() & BL_TRACK))
             stream_type = StreamType::PRIVATE_DATA;
         // Dolby Vision profile 5 is not compatible with SDR or HDR and must be stream_type 06 = private data
-        // else if (V3_flags & BL_NOTCOMPAT)
+        // else if (v3Info().flags() & BL_NOTCOMPAT)
         //     stream_type = StreamType::PRIVATE_DATA;
 
         m_pmt.pidList[tsStreamIndex] =
@@ -404,8 +434,7 @@ bool TSMuxer::doFlush()
         newPCR = (m_endStreamDTS - m_minDts) / INT_FREQ_TO_TS_FREQ + m_fixed_pcr_offset;
         if (m_cbrBitrate != -1 && m_lastPCR != -1)
         {
-            const auto cbrPCR = llround(static_cast<double>(m_lastPCR + m_pcrBits) * 90000.0 / m_cbrBitrate);
-            newPCR = FFMAX(newPCR, cbrPCR);
+            newPCR = FFMAX(newPCR, cbrPCR());
         }
     }
     return doFlush(newPCR, 0);
@@ -434,14 +463,14 @@ bool TSMuxer::doFlush(const int64_t newPCR, const int64_t pcrGAP)
         if (lastBlockSize > 0)
         {
             assert(m_sectorSize == 0);  // we should not be here in interleaved mode!
-            const auto newBuff = new uint8_t[lastBlockSize];
+            const auto newBuff = m_blockPool->acquire();
             memcpy(newBuff, m_outBuf + roundBufLen, lastBlockSize);
-            m_owner->asyncWriteBuffer(this, m_outBuf, roundBufLen, m_muxFile);
+            m_owner->asyncWriteBuffer(this, m_outBuf, roundBufLen, m_muxFile, m_blockPool);
             m_outBuf = newBuff;
         }
         else
         {
-            m_owner->asyncWriteBuffer(this, m_outBuf, roundBufLen, m_muxFile);
+            m_owner->asyncWriteBuffer(this, m_outBuf, roundBufLen, m_muxFile, m_blockPool);
             m_outBuf = nullptr;
         }
     }
@@ -503,9 +532,9 @@ void TSMuxer::processM2TSPCR(const int64_t pcrVal, const int64_t pcrGAP)
     const int m2tsFrameCnt = calcM2tsFrameCnt();
     const int64_t hiResPCR = pcrVal * 300 - pcrGAP;
     const int64_t pcrValDif = hiResPCR - m_prevM2TSPCR;  // m2ts pcr clock based on full 27Mhz counter
-    const double pcrIncPerFrame = static_cast<double>(pcrValDif) / m2tsFrameCnt;
 
-    auto curM2TSPCR = static_cast<double>(m_prevM2TSPCR);
+    // the arrival time stamps are spread evenly between the previous PCR and this one, in exact integer arithmetic
+    int64_t frameNum = 0;
     uint8_t* curPos;
     if (!m_m2tsDelayBlocks.empty())
     {
@@ -516,16 +545,15 @@ void TSMuxer::processM2TSPCR(const int64_t pcrVal, const int64_t pcrGAP)
             int j = offset;
             for (; j < i.second; j += 192)
             {
-                curM2TSPCR += pcrIncPerFrame;
-                writeM2TSHeader(curPos, llround(curM2TSPCR));
+                writeM2TSHeader(curPos, m_prevM2TSPCR + roundDiv(pcrValDif * ++frameNum, m2tsFrameCnt));
                 curPos += 192;
             }
             if (m_owner->isAsyncMode())
-                m_owner->asyncWriteBuffer(this, i.first, i.second, m_muxFile);
+                m_owner->asyncWriteBuffer(this, i.first, i.second, m_muxFile, m_blockPool);
             else
             {
                 m_owner->syncWriteBuffer(this, i.first, i.second, m_muxFile);
-                delete[] i.first;
+                m_blockPool->release(i.first);
             }
             offset = j - i.second;
         }
@@ -535,13 +563,9 @@ void TSMuxer::processM2TSPCR(const int64_t pcrVal, const int64_t pcrGAP)
     curPos = m_outBuf + m_prevM2TSPCROffset;
     const uint8_t* end = m_outBuf + m_outBufLen;
     for (; curPos < end; curPos += 192)
-    {
-        curM2TSPCR += pcrIncPerFrame;
-        writeM2TSHeader(curPos, llround(curM2TSPCR));
-    }
+        writeM2TSHeader(curPos, m_prevM2TSPCR + roundDiv(pcrValDif * ++frameNum, m2tsFrameCnt));
     assert(curPos == end);
     m_prevM2TSPCROffset = m_outBufLen;
-    // assert((int64_t) curM2TSPCR == hiResPCR);
     m_prevM2TSPCR = hiResPCR;
 }
 
@@ -691,6 +715,8 @@ bool TSMuxer::isSplitPoint(const AVPacket& avPacket) const
     return false;
 }
 
+V3Info& TSMuxer::v3Info() const { return m_owner->v3Info(); }
+
 int TSMuxer::getFirstFileNum() const
 {
     const string fileName = extractFileName(m_origFileName);
@@ -847,7 +873,7 @@ void TSMuxer::writePCR(const int64_t newPCR)
     int bitsRest = 0;
     if (m_cbrBitrate != -1 && m_minBitrate != -1 && m_lastPCR != -1)
     {
-        int expectedBits = lroundl(static_cast<double>(newPCR - m_lastPCR) / 90000.0 * m_minBitrate);
+        auto expectedBits = static_cast<int>(roundDiv((newPCR - m_lastPCR) * m_minBitrate, 90000));
         expectedBits -= m_pcrBits;
         if (expectedBits > 0)
         {
@@ -865,6 +891,15 @@ void TSMuxer::writePCR(const int64_t newPCR)
     m_lastPCR = newPCR;
 }
 
+int64_t TSMuxer::cbrPCR() const { return roundDiv((m_lastPCR + m_pcrBits) * 90000, m_cbrBitrate); }
+
+int64_t TSMuxer::cbrPCRBitsThreshold() const
+{
+    // smallest m_pcrBits for which cbrPCR() - m_lastPCR >= m_pcr_delta
+    const int64_t num = (m_lastPCR + m_pcr_delta) * m_cbrBitrate - m_cbrBitrate / 2;
+    return (num > 0 ? (num + 89999) / 90000 : num / 90000) - m_lastPCR;
+}
+
 void TSMuxer::flushTSBuffer()
 {
     if (m_owner->isAsyncMode())
@@ -880,7 +915,8 @@ void TSMuxer::flushTSBuffer()
 
     if (writeOutFile(m_outBuf, m_outBufLen) != m_outBufLen)
         THROW(ERR_FILE_COMMON, "Can't write last data block to file " << m_outFileName)
-    delete[] m_outBuf;
+    m_blockPool->release(m_outBuf);
+    m_outBuf = nullptr;
     m_outBufLen = 0;
 }
 
@@ -898,7 +934,8 @@ void TSMuxer::finishFileBlock(const int64_t newPts, const int64_t newPCR, const
             assert(m_outBuf == nullptr && m_outBufLen == 0);
         else
             flushTSBuffer();
-        m_outBuf = new uint8_t[m_writeBlockSize + 1024];
+        if (m_outBuf == nullptr)
+            m_outBuf = m_blockPool->acquire();
         m_prevM2TSPCROffset = 0;
     }
 
@@ -965,7 +1002,10 @@ bool TSMuxer::muxPacket(AVPacket& avPacket)
     if (m_minDts == -1)
         m_minDts = avPacket.dts;
 
-    const int tsIndex = m_extIndexToTSIndex[avPacket.stream_index];
+    const int streamIndex = avPacket.stream_index;
+    const int tsIndex = streamIndex >= 0 && streamIndex < static_cast<int>(m_extIndexToTSIndex.size())
+                            ? m_extIndexToTSIndex[streamIndex]
+                            : 0;
     if (tsIndex == 0)
         THROW(ERR_TS_COMMON, "Unknown track number " << avPacket.stream_index)
 
@@ -977,7 +1017,8 @@ bool TSMuxer::muxPacket(AVPacket& avPacket)
     }
 
     bool newPES = false;
-    if (avPacket.dts != m_streamInfo[tsIndex].m_dts || avPacket.pts != m_streamInfo[tsIndex].m_pts ||
+    StreamInfo& streamInfo = m_streamInfo[tsIndex];
+    if (avPacket.dts != streamInfo.m_dts || avPacket.pts != streamInfo.m_pts ||
         tsIndex != m_lastTSIndex || avPacket.flags & AVPacket::FORCE_NEW_FRAME)
     {
         writePESPacket();
@@ -988,10 +1029,13 @@ bool TSMuxer::muxPacket(AVPacket& avPacket)
 
     if (m_cbrBitrate != -1 && m_lastPCR != -1)
     {
-        const auto cbrPCR = llround(static_cast<double>(m_lastPCR + m_pcrBits) * 90000.0 / m_cbrBitrate);
-        newPCR = FFMAX(newPCR, cbrPCR);
+        newPCR = FFMAX(newPCR, cbrPCR());
     }
 
+    // the sibling muxer may run on another thread: it is in sync with this muxer while its block is checked
+    const bool switchBlocks = m_sublingMuxer && m_canSwithBlock;
+    if (newPES && switchBlocks)
+        m_owner->beginBlockSwitch(this);
     if (newPES && m_canSwithBlock && isSplitPoint(avPacket))
     {
         finishFileBlock(avPacket.pts, newPCR, true);  // goto next file
@@ -1009,10 +1053,12 @@ bool TSMuxer::muxPacket(AVPacket& avPacket)
             writePCR(newPCR);
         }
     }
+    if (switchBlocks)
+        m_owner->endBlockSwitch(this);
 
-    m_streamInfo[tsIndex].m_pts = avPacket.pts;
-    m_streamInfo[tsIndex].m_dts = avPacket.dts;
-    uint8_t pesStreamID = m_pesType[tsIndex];
+    streamInfo.m_pts = avPacket.pts;
+    streamInfo.m_dts = avPacket.dts;
+    uint8_t pesStreamID = streamInfo.m_pesType;
     if (pesStreamID <= SYSTEM_START_CODE)
     {
         if (m_useNewStyleAudioPES)
@@ -1037,80 +1083,103 @@ bool TSMuxer::muxPacket(AVPacket& avPacket)
 int TSMuxer::writeTSFrames(const int pid, const uint8_t* buffer, const int64_t len, const bool priorityData,
                            bool payloadStart)
 {
+    static constexpr int TS_PAYLOAD_SIZE = TS_FRAME_SIZE - TSPacket::TS_HEADER_SIZE;
+
     int result = 0;
 
     const uint8_t* curPos = buffer;
     const uint8_t* end = buffer + len;
 
-    const bool tsPriority = priorityData;
     StreamInfo& streamInfo = m_streamInfo[pid];
+    // the packets only differ by the continuity counter and the payload start flag
+    const uint32_t tsHeader = TSPacket::buildHeader(pid, priorityData);
+    const bool cbrMode = m_cbrBitrate != -1 && m_lastPCR != -1;
+    const int stride = m_m2tsMode ? TS_FRAME_SIZE + 4 : TS_FRAME_SIZE;
+    // in CBR mode, a PCR is inserted once m_pcrBits reaches this value
+    int64_t pcrBitsThreshold = cbrMode ? cbrPCRBitsThreshold() : INT64_MAX;
 
     while (curPos < end)
     {
-        if (m_cbrBitrate != -1 && m_lastPCR != -1)
+        if (m_pcrBits >= pcrBitsThreshold)
         {
-            const auto newPCR = llround(static_cast<double>(m_lastPCR + m_pcrBits) * 90000.0 / m_cbrBitrate);
-            if (newPCR - m_lastPCR >= m_pcr_delta && m_lastPCR != -1)
+            const int64_t newPCR = cbrPCR();
+            m_pcrBits = 0;
+            writePATPMT(newPCR);
+            writePCR(newPCR);
+            if (m_lastPESDTS != -1 && m_lastPCR > m_lastPESDTS)
             {
-                m_pcrBits = 0;
-                writePATPMT(newPCR);
-                writePCR(newPCR);
-                if (m_lastPESDTS != -1 && m_lastPCR > m_lastPESDTS)
-                {
-                    LTRACE(LT_ERROR, 2,
-                           "VBV buffer overflow at position " << (double)(m_lastPCR - m_fixed_pcr_offset) / 90000.0
-                                                              << " sec");
-                }
+                LTRACE(LT_ERROR, 2,
+                       "VBV buffer overflow at position " << (double)(m_lastPCR - m_fixed_pcr_offset) / 90000.0
+                                                          << " sec");
             }
+            pcrBitsThreshold = cbrPCRBitsThreshold();
         }
 
-        if (m_m2tsMode)
+        const int64_t tmpBufferLen = end - curPos;
+        if (tmpBufferLen >= TS_PAYLOAD_SIZE)
         {
-            m_outBufLen += 4;
-            m_processedBlockSize += 4;
-            m_pcrBits += 4 * 8;
+            // Run of full packets, up to the next flush of the output buffer or the next CBR PCR. The M2TS headers
+            // are filled later, when the PCR following them is known.
+            const int64_t packets =
+                min({tmpBufferLen / TS_PAYLOAD_SIZE,
+                     max<int64_t>(m_writeBlockSize - m_outBufLen + stride - 1, stride) / stride,
+                     (pcrBitsThreshold - m_pcrBits - 1) / (stride * 8) + 1});
+            uint8_t* dst = m_outBuf + m_outBufLen + stride - TS_FRAME_SIZE;
+            for (int64_t i = 0; i < packets; ++i)
+            {
+                const uint32_t header = tsHeader + (payloadStart ? TSPacket::PAYLOAD_START_BIT_VAL : 0) +
+                                        ((streamInfo.m_tsCnt++ & 0x0f) << TSPacket::COUNTER_SHIFT);
+                payloadStart = false;
+                memcpy(dst, &header, TSPacket::TS_HEADER_SIZE);
+                memcpy(dst + TSPacket::TS_HEADER_SIZE, curPos, TS_PAYLOAD_SIZE);
+                curPos += TS_PAYLOAD_SIZE;
+                dst += stride;
+            }
+            const auto size = static_cast<int>(packets * stride);
+            m_outBufLen += size;
+            m_processedBlockSize += size;
+            m_pcrBits += size * 8;
+            m_muxedPacketCnt[m_muxedPacketCnt.size() - 1] += static_cast<uint32_t>(packets);
+            result += static_cast<int>(packets);
         }
-        const int64_t tmpBufferLen = end - curPos;
-        const auto initTS = reinterpret_cast<uint32_t*>(m_outBuf + m_outBufLen);
-        *initTS = TSPacket::TS_FRAME_SYNC_BYTE + TSPacket::DATA_EXIST_BIT_VAL;
-        const auto tsPacket = reinterpret_cast<TSPacket*>(m_outBuf + m_outBufLen);
-        int64_t payloadLen = TS_FRAME_SIZE - tsPacket->getHeaderSize();
-        tsPacket->setPID(pid);
-        tsPacket->counter = streamInfo.m_tsCnt++;
-        tsPacket->payloadStart = payloadStart;  // curPos == buffer;
-        payloadStart = false;
-        tsPacket->priority = tsPriority;
-        if (tmpBufferLen < payloadLen)
+        else
         {
-            // insert padding bytes
-            if (!tsPacket->afExists)
+            // last packet of the buffer: the payload is completed with adaptation field stuffing
+            if (m_m2tsMode)
             {
-                tsPacket->afExists = 1;
-                if (payloadLen - tmpBufferLen == 1)
-                {
-                    tsPacket->adaptiveField.length = 0;
-                    payloadLen--;
-                }
-                else
-                {
-                    initTS[1] = 0x01;  // zero all af flags, set af len to 1.
-                    payloadLen -= 2;
-                }
+                m_outBufLen += 4;
+                m_processedBlockSize += 4;
+                m_pcrBits += 4 * 8;
+            }
+            const auto initTS = reinterpret_cast<uint32_t*>(m_outBuf + m_outBufLen);
+            *initTS = tsHeader + (payloadStart ? TSPacket::PAYLOAD_START_BIT_VAL : 0);
+            const auto tsPacket = reinterpret_cast<TSPacket*>(m_outBuf + m_outBufLen);
+            tsPacket->counter = streamInfo.m_tsCnt++;
+            payloadStart = false;
+            int64_t payloadLen = TS_PAYLOAD_SIZE;
+            tsPacket->afExists = 1;
+            if (payloadLen - tmpBufferLen == 1)
+            {
+                tsPacket->adaptiveField.length = 0;
+                payloadLen--;
+            }
+            else
+            {
+                initTS[1] = 0x01;  // zero all af flags, set af len to 1.
+                payloadLen -= 2;
             }
             memset(reinterpret_cast<uint8_t*>(tsPacket) + tsPacket->getHeaderSize(), 0xff, payloadLen - tmpBufferLen);
             tsPacket->adaptiveField.length += static_cast<unsigned>(payloadLen - tmpBufferLen);
-            payloadLen = tmpBufferLen;
+            memcpy(m_outBuf + m_outBufLen + tsPacket->getHeaderSize(), curPos, tmpBufferLen);
+
+            curPos = end;
+            m_outBufLen += TS_FRAME_SIZE;
+            m_processedBlockSize += TS_FRAME_SIZE;
+            m_pcrBits += TS_FRAME_SIZE * 8;
+            m_muxedPacketCnt[m_muxedPacketCnt.size() - 1]++;
+            result++;
         }
-        const int tsHeaderSize = tsPacket->getHeaderSize();
-        memcpy(m_outBuf + m_outBufLen + tsHeaderSize, curPos, payloadLen);
-
-        curPos += payloadLen;
-        m_outBufLen += TS_FRAME_SIZE;
-        m_processedBlockSize += TS_FRAME_SIZE;
-        m_pcrBits += TS_FRAME_SIZE * 8;
-        m_muxedPacketCnt[m_muxedPacketCnt.size() - 1]++;
         writeOutBuffer();
-        result++;
     }
     return result;
 }
@@ -1266,6 +1335,8 @@ void TSMuxer::writeSIT()
         m_pcrBits += 4 * 8;
     }
     memcpy(m_outBuf + m_outBufLen, DefaultSitTableOne, TS_FRAME_SIZE);
+    if (v3Info().hevcPeakRate())
+        memcpy(m_outBuf + m_outBufLen + 17, SitTableHEVC, sizeof(SitTableHEVC));
     const auto tsPacket = reinterpret_cast<TSPacket*>(m_outBuf + m_outBufLen);
     tsPacket->counter = m_sitCnt++;
     m_outBufLen += TS_FRAME_SIZE;
@@ -1279,44 +1350,32 @@ void TSMuxer::writeOutBuffer()
 {
     if (m_outBufLen >= m_writeBlockSize)
     {
-        int toFileLen = m_writeBlockSize & ~(MuxerManager::PHYSICAL_SECTOR_SIZE - 1);
-        if (m_owner->isAsyncMode())
+        int toFileLen = m_writeBlockSize / m_writeAlign * m_writeAlign;
+        if (m_m2tsMode && (m_prevM2TSPCROffset < toFileLen || !m_m2tsDelayBlocks.empty()))
         {
-            const auto newBuf = new uint8_t[m_writeBlockSize + 1024];
+            // The arrival time stamps of the block are known on the next PCR only. The block is kept as is until then
+            // and the output continues in a new block of the pool: only the tail of the buffer is copied.
+            const auto newBuf = m_blockPool->acquire();
             memcpy(newBuf, m_outBuf + toFileLen, m_outBufLen - toFileLen);
-            if (m_m2tsMode)
-            {
-                if (m_prevM2TSPCROffset >= toFileLen && m_m2tsDelayBlocks.empty())
-                {
-                    m_owner->asyncWriteBuffer(this, m_outBuf, toFileLen, m_muxFile);
-                    m_prevM2TSPCROffset -= toFileLen;
-                }
-                else
-                    m_m2tsDelayBlocks.emplace_back(m_outBuf, toFileLen);
-            }
-            else
-                m_owner->asyncWriteBuffer(this, m_outBuf, toFileLen, m_muxFile);
+            m_m2tsDelayBlocks.emplace_back(m_outBuf, toFileLen);
             m_outBuf = newBuf;
         }
         else
         {
-            if (!m_m2tsMode)
-                m_owner->syncWriteBuffer(this, m_outBuf, toFileLen, m_muxFile);
+            if (m_m2tsMode)
+                m_prevM2TSPCROffset -= toFileLen;
+            if (m_owner->isAsyncMode())
+            {
+                const auto newBuf = m_blockPool->acquire();
+                memcpy(newBuf, m_outBuf + toFileLen, m_outBufLen - toFileLen);
+                m_owner->asyncWriteBuffer(this, m_outBuf, toFileLen, m_muxFile, m_blockPool);
+                m_outBuf = newBuf;
+            }
             else
             {
-                if (m_prevM2TSPCROffset >= toFileLen && m_m2tsDelayBlocks.empty())
-                {
-                    m_owner->syncWriteBuffer(this, m_outBuf, toFileLen, m_muxFile);
-                    m_prevM2TSPCROffset -= toFileLen;
-                }
-                else
-                {
-                    auto newBuf = new uint8_t[toFileLen];
-                    memcpy(newBuf, m_outBuf, toFileLen);
-                    m_m2tsDelayBlocks.emplace_back(newBuf, toFileLen);
-                }
+                m_owner->syncWriteBuffer(this, m_outBuf, toFileLen, m_muxFile);
+                memmove(m_outBuf, m_outBuf + toFileLen, m_outBufLen - toFileLen);
             }
-            memmove(m_outBuf, m_outBuf + toFileLen, m_outBufLen - toFileLen);
         }
         m_outBufLen -= toFileLen;
     }
@@ -1400,6 +1459,7 @@ void TSMuxer::joinToMasterFile()
 {
     m_isExternalFile = true;
     m_muxFile = m_sublingMuxer->getDstFile();
+    m_writeAlign = m_sublingMuxer->m_writeAlign;
 }
 
 void TSMuxer::setMasterMode(AbstractMuxer* subMuxer, const bool flushInterleavedBlock)
@@ -1419,8 +1479,24 @@ void TSMuxer::openDstFile()
     if (m_owner->isAsyncMode())
         systemFlags += FILE_FLAG_NO_BUFFERING;
 #endif
-    if (!m_muxFile->open(m_outFileName.c_str(), File::ofWrite, systemFlags))
+    // the unaligned tail of the file is appended through the system cache when the file is closed
+    if (!m_muxFile->open(m_outFileName.c_str(), m_owner->getOutputFileFlags(), systemFlags))
         THROW(ERR_CANT_CREATE_FILE, "Can't create file " << m_outFileName)
+    // blocks aligned for direct IO are written directly
+    m_writeAlign = static_cast<int>(
+        std::max<uint32_t>(MuxerManager::PHYSICAL_SECTOR_SIZE, m_muxFile->directIOAlign()));
+    preallocateDstFile();
+}
+
+void TSMuxer::preallocateDstFile() const
+{
+    // TS packet and PES headers add a few percent to the size of the source streams
+    int64_t size = m_owner->totalSize() + m_owner->totalSize() / 8;
+    for (const auto& packetCnt : m_muxedPacketCnt) size -= static_cast<int64_t>(packetCnt) * m_frameSize;
+    if (m_splitSize > 0)
+        size = std::min(size, static_cast<int64_t>(m_splitSize) + m_splitSize / 8);
+    if (size > 0)
+        m_muxFile->preallocate(size);
 }
 
 vector<int64_t> TSMuxer::getFirstPts() const
@@ -1473,7 +1549,8 @@ void TSMuxer::setMuxFormat(const std::string& format)
 {
     m_m2tsMode = format == "M2TS" || format == "M2T" || format == "MTS" || format == "SSIF";
     m_writeBlockSize = m_m2tsMode ? DEFAULT_FILE_BLOCK_SIZE : TS188_ROUND_BLOCK_SIZE;
-    m_outBuf = new uint8_t[m_writeBlockSize + 1024];
+    assert(static_cast<size_t>(m_writeBlockSize) + 1024 <= m_blockPool->blockSize());
+    m_outBuf = m_blockPool->acquire();
     m_frameSize = m_m2tsMode ? 192 : 188;
     if (m_m2tsMode)
         m_sectorSize = 1024 * 6;
@@ -3,7 +3,10 @@
 
 #include <types/types.h>
 
+#include <array>
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <vector>
 
 #include "abstractMuxer.h"
@@ -23,13 +26,39 @@ enum V3Flags
     BL_NOTCOMPAT = 128
 };
 
-extern int V3_flags;
-extern unsigned HDR10_metadata[6];
-extern bool isV3();
-extern bool is4K();
+// Blu-ray V3 properties of a mux job, found in its streams and written in the disc structures. Each job has its own,
+// shared by the muxers of the job. The stream reader threads of the job may set the flags concurrently.
+class V3Info
+{
+   public:
+    V3Info();
+
+    [[nodiscard]] int flags() const { return m_flags.load(std::memory_order_relaxed); }
+    void addFlags(const int flags) { m_flags.fetch_or(flags, std::memory_order_relaxed); }
+    [[nodiscard]] bool isV3() const { return flags() & HDMV_V3; }
+    [[nodiscard]] bool is4K() const { return flags() & FOUR_K; }
+
+    // HDR10 static metadata: display primaries, white point and mastering display luminance
+    void setMasteringDisplay(const std::array<unsigned, 5>& metadata);
+    // the maximum content light level and frame-average light level of the streams are kept
+    void addContentLightLevel(unsigned maxCLL, unsigned maxFALL);
+    [[nodiscard]] std::array<unsigned, 6> getHDR10Metadata() const;
+
+    // the SIT packets of the job carry the peak rate of a HEVC stream
+    void setHevcPeakRate() { m_hevcPeakRate.store(true, std::memory_order_relaxed); }
+    [[nodiscard]] bool hevcPeakRate() const { return m_hevcPeakRate.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<int> m_flags;
+    std::atomic<bool> m_hevcPeakRate;
+    mutable std::mutex m_metadataMtx;
+    std::array<unsigned, 6> m_hdr10Metadata;
+};
 
 static constexpr int MAX_PES_HEADER_LEN = 512;
 
+class OutputBlockPool;
+
 class TSMuxer final : public AbstractMuxer
 {
     typedef AbstractMuxer base_class;
@@ -66,6 +95,8 @@ class TSMuxer final : public AbstractMuxer
     [[nodiscard]] bool isInterleaveMode() const;
     [[nodiscard]] std::vector<int32_t> getInterleaveInfo(size_t idx) const;
     [[nodiscard]] bool isSubStream() const { return m_subMode; }
+    // Blu-ray V3 state of the mux job
+    [[nodiscard]] V3Info& v3Info() const;
 
     void setPtsOffset(int64_t value);
 
@@ -102,6 +133,8 @@ class TSMuxer final : public AbstractMuxer
     }
     void writePATPMT(int64_t pcr, bool force = false);
     void writePCR(int64_t newPCR);
+    [[nodiscard]] int64_t cbrPCR() const;
+    [[nodiscard]] int64_t cbrPCRBitsThreshold() const;
     std::string getNextName(std::string curName) override;
     void writeEmptyPacketWithPCRTest(int64_t pcrVal);
     bool appendM2TSNullPacketToFile(int64_t curFileSize, int counter, int* packetsWrited) const;
@@ -115,6 +148,7 @@ class TSMuxer final : public AbstractMuxer
     void flushTSBuffer();
     void finishFileBlock(int64_t newPts, int64_t newPCR, bool doChangeFile, bool recursive = true);
     void gotoNextFile(int64_t newPts);
+    void preallocateDstFile() const;
 
     AbstractOutputStream* m_muxFile;
     bool m_isExternalFile;
@@ -154,15 +188,17 @@ class TSMuxer final : public AbstractMuxer
         {
             m_pts = m_dts = ULLONG_MAX;
             m_tsCnt = 0;
+            m_pesType = 0;
         }
         int64_t m_pts;
         int64_t m_dts;
         int m_tsCnt;
+        uint8_t m_pesType;
     };
 
     int64_t m_minDts;
     bool m_beforePCRDataWrited;
-    std::map<int, int> m_extIndexToTSIndex;
+    std::vector<int> m_extIndexToTSIndex;  // PID of the tracks, by stream index
     uint16_t m_videoTrackCnt;
     uint16_t m_DVvideoTrackCnt;
     uint16_t m_videoSecondTrackCnt;
@@ -170,10 +206,11 @@ class TSMuxer final : public AbstractMuxer
     uint16_t m_secondaryAudioTrackCnt;
     uint16_t m_pgsTrackCnt;
     int64_t m_lastPCR;
-    std::map<int, StreamInfo> m_streamInfo;
+    PIDTable<StreamInfo> m_streamInfo;
     int64_t m_lastPMTPCR;
-    uint8_t* m_outBuf;
+    uint8_t* m_outBuf;  // block of m_blockPool
     int32_t m_outBufLen;
+    OutputBlockPool* m_blockPool;
     int m_nullCnt;
     int m_pmtCnt;
     int m_patCnt;
@@ -185,7 +222,6 @@ class TSMuxer final : public AbstractMuxer
     uint8_t m_nullBuffer[TS_FRAME_SIZE];
     TS_program_map_section m_pmt;
     TS_program_association_section m_pat;
-    std::map<int, uint8_t> m_pesType;
     bool m_needTruncate;
     int64_t m_lastMuxedDts;
     MemoryBlock m_pesData;
@@ -201,6 +237,7 @@ class TSMuxer final : public AbstractMuxer
 
     std::string m_outFileName;
     int m_writeBlockSize;
+    int m_writeAlign;  // the blocks written are a multiple of it: the sector size, or the direct IO alignment
     int m_frameSize;
     int64_t m_processedBlockSize;
     TSMuxer* m_sublingMuxer;
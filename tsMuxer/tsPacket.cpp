@@ -920,7 +920,7 @@ void CLPIParser::composeEP_map_for_one_stream_PID(BitStreamWriter& writer, M2TSS
             int endCode = 0;
             if (indexData.m_frameLen > 0)
             {
-                if (is4K())
+                if (m_v3Info->is4K())
                 {
                     if (indexData.m_frameLen < 786432)
                         endCode = 1;
@@ -1247,7 +1247,8 @@ MPLSParser::MPLSParser()
       m_m2tsOffset(0),
       isDependStreamExist(false),
       mvc_base_view_r(false),
-      subPath_type(0)
+      subPath_type(0),
+      m_v3Info(nullptr)
 {
     number_of_primary_video_stream_entries = 0;
     number_of_primary_audio_stream_entries = 0;
@@ -1381,7 +1382,7 @@ int MPLSParser::composeSTN_tableSS(uint8_t* buffer, const int bufferSize)
     }
 };
 
-int MPLSParser::composeUHD_metadata(uint8_t* buffer, const int bufferSize)
+int MPLSParser::composeUHD_metadata(uint8_t* buffer, const int bufferSize) const
 {
     BitStreamWriter writer{};
     writer.setBuffer(buffer, buffer + bufferSize);
@@ -1390,7 +1391,7 @@ int MPLSParser::composeUHD_metadata(uint8_t* buffer, const int bufferSize)
         writer.putBits(32, 0x20);
         writer.putBits(32, 1 << 24);
         writer.putBits(32, 1 << 28);
-        for (const unsigned i : HDR10_metadata) writer.putBits(32, i);
+        for (const unsigned i : m_v3Info->getHDR10Metadata()) writer.putBits(32, i);
         writer.flushBits();
         return writer.getBitsCount() / 8;
     }
@@ -1426,7 +1427,7 @@ int MPLSParser::compose(uint8_t* buffer, int bufferSize, const DiskType dt)
     const std::string type_indicator = "MPLS";
     std::string version_number;
     if (dt == DiskType::BLURAY)
-        version_number = (isV3() ? "0300" : "0200");
+        version_number = (m_v3Info->isV3() ? "0300" : "0200");
     else
         version_number = "0100";
     CLPIStreamInfo::writeString(type_indicator.c_str(), writer, 4);
@@ -1453,7 +1454,7 @@ int MPLSParser::compose(uint8_t* buffer, int bufferSize, const DiskType dt)
     if (writer.getBitsCount() % 16 != 0)
         writer.putBits(8, 0);
 
-    if (number_of_SubPaths > 0 || isDependStreamExist || isV3())
+    if (number_of_SubPaths > 0 || isDependStreamExist || m_v3Info->isV3())
     {
         *extDataStartAddr = my_htonl(writer.getBitsCount() / 8);
         uint8_t buff[1024 * 4];
@@ -1478,7 +1479,7 @@ int MPLSParser::compose(uint8_t* buffer, int bufferSize, const DiskType dt)
             blockVector.push_back(extDataBlock2);
         }
 
-        if (isV3())
+        if (m_v3Info->isV3())
         {
             bufferSize = composeUHD_metadata(buff, sizeof(buff));
             const ExtDataBlockInfo extDataBlock(buff, bufferSize, 3, 5);
@@ -1530,9 +1531,9 @@ void MPLSParser::composeAppInfoPlayList(BitStreamWriter& writer) const
         writer.putBits(16, 0);  // reserved_for_future_use
     }
     writer.putBits(28, 0);               // UO_mask_table;
-    writer.putBits(4, isV3() ? 15 : 0);  // UO_mask_table;
+    writer.putBits(4, m_v3Info->isV3() ? 15 : 0);  // UO_mask_table;
     writer.putBit(0);                    // reserved
-    writer.putBit(isV3() ? 1 : 0);       // UO_mask_table: SecondaryPGStreamNumberChange
+    writer.putBit(m_v3Info->isV3() ? 1 : 0);       // UO_mask_table: SecondaryPGStreamNumberChange
     writer.putBits(30, 0);               // UO_mask_table cont;
     writer.putBit(0);                    // PlayList_random_access_flag
     writer.putBit(1);  // audio_mix_app_flag. 0 == no secondary audio, 1- allow secondary audio if exist
@@ -2098,9 +2099,9 @@ void MPLSParser::composePlayItem(BitStreamWriter& writer, const size_t playItemN
         writer.putBits(32, OUT_time);
 
     writer.putBits(28, 0);               // UO_mask_table;
-    writer.putBits(4, isV3() ? 15 : 0);  // UO_mask_table;
+    writer.putBits(4, m_v3Info->isV3() ? 15 : 0);  // UO_mask_table;
     writer.putBit(0);                    // reserved
-    writer.putBit(isV3() ? 1 : 0);       // UO_mask_table: SecondaryPGStreamNumberChange
+    writer.putBit(m_v3Info->isV3() ? 1 : 0);       // UO_mask_table: SecondaryPGStreamNumberChange
     writer.putBits(30, 0);               // UO_mask_table cont;
 
     writer.putBit(PlayItem_random_access_flag);
@@ -2467,8 +2468,8 @@ void MPLSParser::STN_table(BitStreamReader& reader, int PlayItem_id)
 // ------------- M2TSStreamInfo -----------------------
 
 void M2TSStreamInfo::blurayStreamParams(const double fps, const bool interlaced, const unsigned width,
-                                        const unsigned height, const VideoAspectRatio ar, uint8_t* video_format,
-                                        uint8_t* frame_rate_index, uint8_t* aspect_ratio_index)
+                                        const unsigned height, const VideoAspectRatio ar, const bool v3Mode,
+                                        uint8_t* video_format, uint8_t* frame_rate_index, uint8_t* aspect_ratio_index)
 {
     *video_format = 0;
     *frame_rate_index = 0;
@@ -2487,9 +2488,9 @@ void M2TSStreamInfo::blurayStreamParams(const double fps, const bool interlaced,
     else
         *video_format = 5;  // as 1280x720
 
-    if (width < 1080 && isV3())
+    if (width < 1080 && v3Mode)
         LTRACE(LT_WARN, 2, "Warning: video height < 1080 is not standard for V3 Blu-ray.");
-    if (interlaced && isV3())
+    if (interlaced && v3Mode)
         LTRACE(LT_WARN, 2, "Warning: interlaced video is not standard for V3 Blu-ray.");
 
     if (fabs(fps - 23.976) < 1e-4)
@@ -2535,8 +2536,8 @@ M2TSStreamInfo::M2TSStreamInfo(const PMTStreamInfo& pmtStreamInfo)
             height = vStream->getStreamHeight();
             HDR = vStream->getStreamHDR();
             const VideoAspectRatio ar = vStream->getStreamAR();
-            blurayStreamParams(vStream->getFPS(), vStream->getInterlaced(), width, height, ar, &video_format,
-                               &frame_rate_index, &aspect_ratio_index);
+            blurayStreamParams(vStream->getFPS(), vStream->getInterlaced(), width, height, ar,
+                               vStream->getV3Info()->isV3(), &video_format, &frame_rate_index, &aspect_ratio_index);
             if (ar == VideoAspectRatio::AR_3_4)
                 width = height * 4 / 3;
             else if (ar == VideoAspectRatio::AR_16_9)
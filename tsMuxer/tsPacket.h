@@ -4,7 +4,10 @@
 #include <memory.h>
 #include <types/types.h>
 
+#include <array>
+#include <deque>
 #include <map>
+#include <vector>
 
 #include "avPacket.h"
 #include "bitStream.h"
@@ -153,6 +156,16 @@ struct TSPacket
 
     static constexpr unsigned DATA_EXIST_BIT_VAL = 0x10000000;
     static constexpr unsigned PCR_BIT_VAL = 0x1000;
+    static constexpr unsigned PRIORITY_BIT_VAL = 0x2000;
+    static constexpr unsigned PAYLOAD_START_BIT_VAL = 0x4000;
+    static constexpr int COUNTER_SHIFT = 24;
+
+    // first 4 bytes of a packet carrying data, as written to a little endian uint32_t. The counter is left to zero.
+    static constexpr uint32_t buildHeader(const int pid, const bool priority)
+    {
+        return TS_FRAME_SYNC_BYTE + DATA_EXIST_BIT_VAL + ((pid >> 8 & 0x1f) << 8) + ((pid & 0xff) << 16) +
+               (priority ? PRIORITY_BIT_VAL : 0);
+    }
 
     unsigned int syncByte : 8;
     unsigned int PIDHi : 5;
@@ -203,7 +216,56 @@ struct TSPacket
     AdaptiveField adaptiveField;
 };
 
+// Per-PID state of a transport stream. A PID is mapped to its state by a direct lookup in a 13-bit index. The
+// states of the PIDs in use are stored in a deque, so they have stable addresses: references to a state stay valid
+// while other PIDs are added, until clear().
+template <typename T>
+class PIDTable
+{
+   public:
+    static constexpr int PID_COUNT = 8192;
+
+    PIDTable() { m_index.fill(NO_SLOT); }
+
+    // state of the PID, a default constructed state is added on first access
+    T& operator[](const int pid)
+    {
+        uint16_t& slot = m_index[pid & (PID_COUNT - 1)];
+        if (slot == NO_SLOT)
+        {
+            slot = static_cast<uint16_t>(m_pids.size());
+            m_pids.push_back(pid);
+            m_states.emplace_back();
+        }
+        return m_states[slot];
+    }
+
+    // nullptr if the PID has not been accessed yet
+    T* find(const int pid)
+    {
+        const uint16_t slot = m_index[pid & (PID_COUNT - 1)];
+        return slot == NO_SLOT ? nullptr : &m_states[slot];
+    }
+
+    [[nodiscard]] bool contains(const int pid) const { return m_index[pid & (PID_COUNT - 1)] != NO_SLOT; }
+
+    void clear()
+    {
+        for (const int pid : m_pids) m_index[pid & (PID_COUNT - 1)] = NO_SLOT;
+        m_pids.clear();
+        m_states.clear();
+    }
+
+   private:
+    static constexpr uint16_t NO_SLOT = 0xffff;
+
+    std::array<uint16_t, PID_COUNT> m_index;
+    std::vector<int> m_pids;
+    std::deque<T> m_states;
+};
+
 class AbstractStreamReader;
+class V3Info;
 
 struct BluRayCoarseInfo
 {
@@ -353,8 +415,10 @@ struct M2TSStreamInfo
     bool isSecondary;
     std::vector<PMTIndex> m_index;
 
+    // v3Mode warns about the video formats which are not standard for a V3 Blu-ray
     static void blurayStreamParams(double fps, bool interlaced, unsigned width, unsigned height, VideoAspectRatio ar,
-                                   uint8_t* video_format, uint8_t* frame_rate_index, uint8_t* aspect_ratio_index);
+                                   bool v3Mode, uint8_t* video_format, uint8_t* frame_rate_index,
+                                   uint8_t* aspect_ratio_index);
 };
 
 struct CLPIStreamInfo : M2TSStreamInfo
@@ -425,7 +489,8 @@ class CLPIParser
           presentation_start_time(0),
           presentation_end_time(0),
           m_clpiNum(0),
-          isDependStream(false)
+          isDependStream(false),
+          m_v3Info(nullptr)
     {
     }
 
@@ -453,6 +518,7 @@ class CLPIParser
     std::vector<uint32_t> SPN_extent_start;
     std::vector<int32_t> interleaveInfo;
     bool isDependStream;
+    const V3Info* m_v3Info;  // Blu-ray V3 state of the disc, required by compose()
 
    private:
     static void HDMV_LPCM_down_mix_coefficient(uint8_t* buffer, unsigned dataLength);
@@ -578,6 +644,7 @@ struct MPLSParser
     uint8_t number_of_DolbyVision_video_stream_entries;
 
     std::vector<std::string> m_mvcFiles;
+    const V3Info* m_v3Info;  // Blu-ray V3 state of the disc, required by compose()
 
    private:
     void composeSubPlayItem(BitStreamWriter& writer, size_t playItemNum, size_t subPathNum,
@@ -605,7 +672,7 @@ struct MPLSParser
     void composeSTN_table(BitStreamWriter& writer, size_t PlayItem_id, bool isSSEx);
     int composeSTN_tableSS(uint8_t* buffer, int bufferSize);
     int composeSubPathEntryExtension(uint8_t* buffer, int bufferSize);
-    static int composeUHD_metadata(uint8_t* buffer, int bufferSize);
+    [[nodiscard]] int composeUHD_metadata(uint8_t* buffer, int bufferSize) const;
     MPLSStreamInfo& getMainStream();
     MPLSStreamInfo& getMVCDependStream();
     static int calcPlayItemID(const MPLSStreamInfo& streamInfo, uint32_t pts);
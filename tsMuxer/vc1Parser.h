@@ -7,6 +7,7 @@
 #include <types/types.h>
 
 #include "bitStream.h"
+#include "startCode.h"
 #include "vod_common.h"
 
 enum class VC1Code
@@ -62,23 +63,7 @@ class VC1Unit
 
     static bool isMarker(const uint8_t* ptr) { return ptr[0] == ptr[1] == 0 && ptr[2] == 1; }
 
-    static uint8_t* findNextMarker(uint8_t* buffer, uint8_t* end)
-    {
-        for (buffer += 2; buffer < end;)
-        {
-            if (*buffer > 1)
-                buffer += 3;
-            else if (*buffer == 0)
-                buffer++;
-            else  // *buffer == 1
-            {
-                if (buffer[-2] == 0 && buffer[-1] == 0)
-                    return buffer - 2;
-                buffer += 3;
-            }
-        }
-        return end;
-    }
+    static uint8_t* findNextMarker(uint8_t* buffer, uint8_t* end) { return findStartCode(buffer, end); }
 
     int64_t vc1_unescape_buffer(uint8_t* src, const int64_t size)
     {
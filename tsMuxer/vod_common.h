@@ -3,6 +3,7 @@
 
 #include <types/types.h>
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -10,7 +11,7 @@
 #include <vector>
 
 #if 1
-extern bool sLastMsg;
+extern std::atomic<bool> sLastMsg;  // messages may be logged by the stream reader threads
 #define LTRACE(level, errIndex, msg)               \
     do                                             \
     {                                              \
@@ -12,23 +12,9 @@ static constexpr int EXTENDED_SAR = 255;
 
 // ------------------------- VvcUnit -------------------
 
-unsigned VvcUnit::extractUEGolombCode()
-{
-    unsigned cnt = 0;
-    for (; !m_reader.getBit(); cnt++)
-        ;
-    if (cnt > INT_BIT)
-        THROW_BITSTREAM_ERR;
-    return (1 << cnt) - 1 + m_reader.getBits(cnt);
-}
+unsigned VvcUnit::extractUEGolombCode() { return m_reader.getUEGolombCode(); }
 
-int VvcUnit::extractSEGolombCode()
-{
-    const unsigned rez = extractUEGolombCode();
-    if (rez % 2 == 0)
-        return -static_cast<int>(rez / 2);
-    return static_cast<int>((rez + 1) / 2);
-}
+int VvcUnit::extractSEGolombCode() { return m_reader.getSEGolombCode(); }
 
 void VvcUnit::decodeBuffer(const uint8_t* buffer, const uint8_t* end)
 {
@@ -46,6 +46,7 @@ void buildWaveHeader(MemoryBlock& waveBuffer, const int samplerate, const uint16
     waveBuffer.clear();
     waveBuffer.grow(40 + 28);
     uint8_t* curPos = waveBuffer.data();
+    memset(curPos, 0, 40 + 28);
     for (const char c : "RIFF\x00\x00\x00\x00WAVEfmt ") *curPos++ = c;
     curPos--;
     const auto fmtSize = reinterpret_cast<uint32_t*>(curPos);